@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "astar.h"
+#include "connection_graph.h"
+
+// Compares compute_fewest_transfers() with an exhaustive fixpoint over the
+// raw runs, which knows nothing about trips and patterns. A traveller is
+// at a (stop, line) state: taking a run of the same line is free, boarding
+// any other line costs a transfer, and the first boarding at the start
+// stop is free. For every transfer count k the earliest arrival at every
+// state with at most k transfers is relaxed until nothing changes; the
+// first k reaching the end stop and its arrival have to match the search.
+//
+// Usage: check_fewest_transfers [--queries N] [--seed N]
+//     [--input connection_graph.csv]
+
+struct state_run {
+    const graph_edge* edge;
+    int start_state;
+    int end_state;
+};
+
+struct fixpoint_result {
+    int transfers;
+    int arrival_time;
+};
+
+// Returns transfers -1 if the end stop cannot be reached
+static fixpoint_result fewest_transfers(const std::vector<state_run>& runs, int state_count,
+    int stop_count, int start_stop_id, int end_stop_id, int start_stop_time)
+{
+    // Earliest arrival at every state, and at every stop over all its
+    // states, with at most k - 1 and at most k transfers
+    std::vector<int> states(state_count, INT_MAX);
+    std::vector<int> previous_stops(stop_count + 1, INT_MAX);
+
+    for (int k = 0;; ++k) {
+        bool changed = true;
+        bool improved = false;
+
+        while (changed) {
+            changed = false;
+
+            for (const state_run& run : runs) {
+                const graph_edge& edge = *run.edge;
+                bool boardable = states[run.start_state] <= edge.departure_time
+                    || (k == 0 ? edge.start_stop_id == start_stop_id && start_stop_time <= edge.departure_time
+                        : previous_stops[edge.start_stop_id] <= edge.departure_time);
+
+                if (boardable && edge.arrival_time < states[run.end_state]) {
+                    states[run.end_state] = edge.arrival_time;
+                    changed = improved = true;
+                }
+            }
+        }
+
+        std::vector<int> stops(stop_count + 1, INT_MAX);
+        for (const state_run& run : runs) {
+            int end_stop_id = run.edge->end_stop_id;
+            stops[end_stop_id] = std::min(stops[end_stop_id], states[run.end_state]);
+        }
+
+        if (stops[end_stop_id] < INT_MAX) {
+            return { k, stops[end_stop_id] };
+        }
+
+        if (!improved && k > 0) {
+            return { -1, -1 };
+        }
+
+        previous_stops = std::move(stops);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int query_count = 100;
+    unsigned seed = 1;
+    const char* input_path = "connection_graph.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            query_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+    }
+
+    std::vector<graph_edge> edges;
+    if (!read_connection_graph(input_path, edges)) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    hash_stop_ids(edges);
+    astar algorithm(edges);
+    algorithm.preprocess();
+    int stop_count = algorithm.get_stop_count();
+
+    // (stop, line) states of the ends of every run
+    std::unordered_map<std::string, int> line_ids;
+    std::unordered_map<std::uint64_t, int> state_ids;
+    auto state_of = [&](int stop_id, const std::string& line) {
+        int line_id = line_ids.emplace(line, static_cast<int>(line_ids.size())).first->second;
+        std::uint64_t key = (static_cast<std::uint64_t>(line_id) << 32) | static_cast<std::uint32_t>(stop_id);
+        return state_ids.emplace(key, static_cast<int>(state_ids.size())).first->second;
+    };
+
+    std::vector<state_run> runs;
+    for (const graph_edge& edge : edges) {
+        runs.push_back({
+            .edge = &edge,
+            .start_state = state_of(edge.start_stop_id, edge.line),
+            .end_state = state_of(edge.end_stop_id, edge.line),
+            });
+    }
+
+    // Sorted by departure a pass or two reaches the fixpoint
+    std::sort(runs.begin(), runs.end(), [](const state_run& first, const state_run& second) {
+        return first.edge->departure_time < second.edge->departure_time;
+    });
+
+    std::mt19937 random(seed);
+    int errors = 0;
+    int reached = 0;
+
+    for (int query = 0; query < query_count; ++query) {
+        int start_stop_id = 1 + random() % stop_count;
+        int end_stop_id = 1 + random() % stop_count;
+        int start_stop_time = 4 * 3600 + random() % (20 * 3600);
+        if (end_stop_id == start_stop_id) {
+            --query;
+            continue;
+        }
+
+        auto reference = fewest_transfers(runs, static_cast<int>(state_ids.size()), stop_count,
+            start_stop_id, end_stop_id, start_stop_time);
+
+        std::ostringstream sink;
+        auto* old_buffer = std::cout.rdbuf(sink.rdbuf());
+        auto result = algorithm.compute_fewest_transfers(start_stop_id, end_stop_id, start_stop_time);
+        std::cout.rdbuf(old_buffer);
+
+        reached += reference.transfers >= 0;
+        errors += result.success ? result.total_vehicle_changes != reference.transfers
+                || result.end_arrival_time != reference.arrival_time
+            : reference.transfers >= 0;
+    }
+
+    std::cout << "Zapytania: " << query_count << ", osiagalne: " << reached;
+    if (errors) {
+        std::cout << ", BLEDNE TRASY: " << errors << std::endl;
+    }
+    else {
+        std::cout << " OK" << std::endl;
+    }
+
+    bool ok = errors == 0;
+    std::cout << (ok ? "Wszystkie przesiadki zgodne" : "Przesiadki niezgodne z punktem stalym") << std::endl;
+    return ok ? 0 : 1;
+}
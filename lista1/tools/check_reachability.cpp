@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "astar.h"
+#include "connection_graph.h"
+
+// Compares the delta-stepping engine with the serial one on random
+// one-to-all queries. Arrival times and reached counts have to be equal.
+// Ties between sources may be broken differently, so a source label is
+// only checked to be one of the query's sources that reaches the stop
+// at that very time on its own.
+//
+// Usage: check_reachability [--queries N] [--threads N] [--seed N]
+//     [--input connection_graph.csv]
+
+struct reachability_query {
+    std::vector<int> start_stop_ids;
+    int start_stop_time;
+    int time_budget;
+    int delta;
+};
+
+static std::vector<reachability_query> make_queries(int stop_count, int query_count, unsigned seed)
+{
+    static const int DELTAS[] = { 30, 120, 600 };
+
+    std::mt19937 random(seed);
+    std::vector<reachability_query> queries(query_count);
+
+    for (auto& query : queries) {
+        int source_count = 1 + random() % 3;
+        for (int i = 0; i < source_count; ++i) {
+            query.start_stop_ids.push_back(1 + random() % stop_count);
+        }
+
+        query.start_stop_time = 5 * 3600 + random() % (17 * 3600);
+        query.time_budget = 60 * (10 + random() % 170);
+        query.delta = DELTAS[random() % std::size(DELTAS)];
+    }
+
+    return queries;
+}
+
+// Returns the number of labels of the map that differ from the serial engine
+static int check_map(const astar& algorithm, const reachability_query& query,
+    const astar::reachability& map)
+{
+    auto reference = algorithm.compute_reachability(
+        query.start_stop_ids, query.start_stop_time, query.time_budget);
+
+    std::vector<astar::reachability> singles;
+    for (int source : query.start_stop_ids) {
+        singles.push_back(algorithm.compute_reachability(source, query.start_stop_time, query.time_budget));
+    }
+
+    int errors = map.reached_count != reference.reached_count;
+    for (int i = 1; i < reference.arrival_times.size(); ++i) {
+        if (map.arrival_times[i] != reference.arrival_times[i]) {
+            ++errors;
+            continue;
+        }
+
+        if (map.arrival_times[i] < 0) {
+            continue;
+        }
+
+        auto it = std::find(query.start_stop_ids.begin(), query.start_stop_ids.end(), map.source_stop_ids[i]);
+        if (it == query.start_stop_ids.end()
+            || singles[it - query.start_stop_ids.begin()].arrival_times[i] != map.arrival_times[i]) {
+            ++errors;
+        }
+    }
+
+    return errors;
+}
+
+int main(int argc, char* argv[])
+{
+    int query_count = 50;
+    int max_threads = 4;
+    unsigned seed = 1;
+    const char* input_path = "connection_graph.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            query_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            max_threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+    }
+
+    std::vector<graph_edge> edges;
+    if (!read_connection_graph(input_path, edges)) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    hash_stop_ids(edges);
+    astar algorithm(edges);
+    algorithm.preprocess();
+
+    auto queries = make_queries(algorithm.get_stop_count(), query_count, seed);
+
+    // All source sets are also solved in one batch, with the start time,
+    // budget and delta of the first query
+    std::vector<std::vector<int>> batch;
+    for (const auto& query : queries) {
+        batch.push_back(query.start_stop_ids);
+    }
+
+    bool ok = true;
+    for (int threads = 1; threads <= max_threads; ++threads) {
+        int errors = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (const auto& query : queries) {
+            auto map = algorithm.compute_reachability_parallel(query.start_stop_ids,
+                query.start_stop_time, query.time_budget, threads, query.delta);
+            errors += check_map(algorithm, query, map);
+        }
+
+        const auto& first = queries.front();
+        auto maps = algorithm.compute_reachability_parallel(batch,
+            first.start_stop_time, first.time_budget, threads, first.delta);
+        for (int i = 0; i < queries.size(); ++i) {
+            reachability_query query = queries[i];
+            query.start_stop_time = first.start_stop_time;
+            query.time_budget = first.time_budget;
+            errors += check_map(algorithm, query, maps[i]);
+        }
+
+        auto duration = std::chrono::steady_clock::now() - start;
+        std::cout << "Watki: " << threads << ", zapytania: " << queries.size()
+            << ", czas: " << std::chrono::duration_cast<std::chrono::milliseconds>(duration);
+        if (errors) {
+            std::cout << ", BLEDNE ETYKIETY: " << errors << std::endl;
+        }
+        else {
+            std::cout << " OK" << std::endl;
+        }
+
+        ok = ok && errors == 0;
+    }
+
+    std::cout << (ok ? "Wszystkie mapy zgodne" : "Mapy niezgodne z silnikiem szeregowym") << std::endl;
+    return ok ? 0 : 1;
+}
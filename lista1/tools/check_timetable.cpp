@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "astar.h"
+#include "connection_graph.h"
+
+// Checks that the route patterns keep the timetable. Small made-up
+// timetables check how runs are chained into trips: a ride along a chain
+// of runs has to stay a single ride, and trips of a line meeting at a stop
+// at the same time, which cannot be chained for sure without trip ids,
+// have to be reported. On the real timetable the earliest arrivals of the
+// one-to-all search and of Dijkstra have to match a fixpoint over the raw
+// runs, which knows nothing about trips and patterns.
+//
+// Usage: check_timetable [--queries N] [--seed N] [--input connection_graph.csv]
+
+static graph_edge make_run(const std::string& line, int departure_time, int arrival_time,
+    int start_stop_id, int end_stop_id)
+{
+    graph_edge edge{};
+    edge.company = "TEST";
+    edge.line = line;
+    edge.departure_time = departure_time;
+    edge.arrival_time = arrival_time;
+    edge.start_stop = "Przystanek " + std::to_string(start_stop_id);
+    edge.end_stop = "Przystanek " + std::to_string(end_stop_id);
+    edge.start_stop_id = start_stop_id;
+    edge.end_stop_id = end_stop_id;
+    edge.start_stop_lat = edge.start_stop_lon = static_cast<float>(start_stop_id);
+    edge.end_stop_lat = edge.end_stop_lon = static_cast<float>(end_stop_id);
+    return edge;
+}
+
+// Rides of the tree from the first stop must reach the last one in a
+// single ride at the given time, with no ambiguous joins of trips
+static bool check_single_ride(const char* name, const std::vector<graph_edge>& edges,
+    int start_stop_id, int end_stop_id, int start_stop_time, int arrival_time)
+{
+    std::ostringstream sink;
+    auto* old_buffer = std::cout.rdbuf(sink.rdbuf());
+
+    astar algorithm(edges);
+    algorithm.preprocess();
+    auto tree = algorithm.compute_ride_tree(start_stop_id, start_stop_time);
+
+    std::cout.rdbuf(old_buffer);
+
+    bool ok = tree.arrival_times[end_stop_id] == arrival_time && tree.ride_counts[end_stop_id] == 1
+        && algorithm.get_ambiguous_join_count() == 0;
+    std::cout << "Rozklad: " << name
+        << ", przyjazd: " << tree.arrival_times[end_stop_id]
+        << ", przejazdy: " << tree.ride_counts[end_stop_id]
+        << ", niejednoznaczne polaczenia: " << algorithm.get_ambiguous_join_count()
+        << (ok ? " OK" : " BLAD") << std::endl;
+
+    return ok;
+}
+
+static bool check_made_up_timetables()
+{
+    bool ok = true;
+
+    // Two runs of zero duration, listed against the order of the trip
+    std::vector<graph_edge> zero_duration = {
+        make_run("Z", 36000, 36300, 3, 4),
+        make_run("Z", 36000, 36000, 2, 3),
+        make_run("Z", 36000, 36000, 1, 2),
+    };
+    ok = check_single_ride("przejazdy zerowej dlugosci", zero_duration, 1, 4, 35000, 36300) && ok;
+
+    // Times of a trip running for weeks, beyond 2^20 seconds, at stops with
+    // large ids
+    std::vector<graph_edge> long_trip;
+    for (int i = 0; i < 40; ++i) {
+        long_trip.push_back(make_run("L", i * 40000, (i + 1) * 40000, 1 + i, 2 + i));
+    }
+    long_trip.push_back(make_run("L", 40 * 40000, 41 * 40000, 41, (1 << 20) + 41));
+    ok = check_single_ride("kurs dluzszy niz 2^20 s", long_trip, 1, (1 << 20) + 41, 0, 41 * 40000) && ok;
+
+    // Two trips of a line meeting at a stop at the same time
+    std::vector<graph_edge> meeting = {
+        make_run("M", 36000, 36300, 1, 3),
+        make_run("M", 36000, 36300, 2, 3),
+        make_run("M", 36300, 36600, 3, 4),
+        make_run("M", 36300, 36600, 3, 5),
+    };
+
+    std::ostringstream sink;
+    auto* old_buffer = std::cout.rdbuf(sink.rdbuf());
+    astar algorithm(meeting);
+    algorithm.preprocess();
+    std::cout.rdbuf(old_buffer);
+
+    bool reported = algorithm.get_ambiguous_join_count() == 1;
+    std::cout << "Rozklad: kursy spotykajace sie na przystanku"
+        << ", niejednoznaczne polaczenia: " << algorithm.get_ambiguous_join_count()
+        << (reported ? " OK" : " BLAD") << std::endl;
+
+    return ok && reported;
+}
+
+// Earliest arrival at every stop over the raw runs, repeated until nothing
+// changes. Runs are sorted by departure, so a pass or two is enough.
+static std::vector<int> earliest_arrivals(const std::vector<const graph_edge*>& runs,
+    int stop_count, int start_stop_id, int start_stop_time)
+{
+    std::vector<int> arrival_times(stop_count + 1, INT_MAX);
+    arrival_times[start_stop_id] = start_stop_time;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (const graph_edge* run : runs) {
+            if (arrival_times[run->start_stop_id] <= run->departure_time
+                && run->arrival_time < arrival_times[run->end_stop_id]) {
+                arrival_times[run->end_stop_id] = run->arrival_time;
+                changed = true;
+            }
+        }
+    }
+
+    for (int& arrival_time : arrival_times) {
+        if (arrival_time == INT_MAX) {
+            arrival_time = -1;
+        }
+    }
+
+    return arrival_times;
+}
+
+int main(int argc, char* argv[])
+{
+    int query_count = 30;
+    unsigned seed = 1;
+    const char* input_path = "connection_graph.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            query_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+    }
+
+    bool ok = check_made_up_timetables();
+
+    std::vector<graph_edge> edges;
+    if (!read_connection_graph(input_path, edges)) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    hash_stop_ids(edges);
+    astar algorithm(edges);
+    algorithm.preprocess();
+    int stop_count = algorithm.get_stop_count();
+
+    std::vector<const graph_edge*> runs;
+    for (const graph_edge& edge : edges) {
+        runs.push_back(&edge);
+    }
+
+    std::sort(runs.begin(), runs.end(), [](const graph_edge* first, const graph_edge* second) {
+        return first->departure_time < second->departure_time;
+    });
+
+    std::mt19937 random(seed);
+    int errors = 0;
+
+    for (int query = 0; query < query_count; ++query) {
+        int start_stop_id = 1 + random() % stop_count;
+        int end_stop_id = 1 + random() % stop_count;
+        int start_stop_time = 4 * 3600 + random() % (20 * 3600);
+
+        auto reference = earliest_arrivals(runs, stop_count, start_stop_id, start_stop_time);
+        auto map = algorithm.compute_reachability(start_stop_id, start_stop_time, 3 * 24 * 3600);
+        errors += map.arrival_times != reference;
+
+        if (end_stop_id == start_stop_id) {
+            continue;
+        }
+
+        std::ostringstream sink;
+        auto* old_buffer = std::cout.rdbuf(sink.rdbuf());
+        auto result = algorithm.compute_dijkstra(start_stop_id, end_stop_id, start_stop_time);
+        std::cout.rdbuf(old_buffer);
+
+        errors += result.success ? result.end_arrival_time != reference[end_stop_id]
+            : reference[end_stop_id] >= 0;
+    }
+
+    std::cout << "Zapytania: " << query_count;
+    if (errors) {
+        std::cout << ", BLEDNE CZASY PRZYJAZDU: " << errors << std::endl;
+    }
+    else {
+        std::cout << " OK" << std::endl;
+    }
+
+    ok = ok && errors == 0;
+    std::cout << (ok ? "Wszystkie przyjazdy zgodne" : "Przyjazdy niezgodne z rozkladem") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "astar.h"
+#include "connection_graph.h"
+#include "transfer_patterns.h"
+
+// Compares queries over transfer patterns with the full searches on random
+// pairs of hubs. At the departure times the patterns were computed for, the
+// fewest transfers query has to match compute_fewest_transfers() in both
+// transfers and arrival, and the earliest arrival query has to arrive with
+// Dijkstra. Between those times patterns may miss the optimum, so matches
+// are only counted there.
+//
+// Usage: check_transfer_patterns [--hubs N] [--queries N] [--seed N]
+//     [--input connection_graph.csv]
+
+static const int FIRST_TIME = 4 * 60 * 60;
+static const int LAST_TIME = 24 * 60 * 60;
+static const int TIME_STEP = 10 * 60;
+
+struct query_outcome {
+    bool time_matches;
+    bool transfers_match;
+};
+
+static query_outcome run_query(astar& algorithm, const transfer_patterns& patterns,
+    int start_stop_id, int end_stop_id, int start_stop_time)
+{
+    std::ostringstream sink;
+    auto* old_buffer = std::cout.rdbuf(sink.rdbuf());
+
+    auto fastest = algorithm.compute_dijkstra(start_stop_id, end_stop_id, start_stop_time);
+    auto fewest = algorithm.compute_fewest_transfers(start_stop_id, end_stop_id, start_stop_time);
+    auto by_time = patterns.compute(start_stop_id, end_stop_id, true, start_stop_time);
+    auto by_transfers = patterns.compute(start_stop_id, end_stop_id, false, start_stop_time);
+
+    std::cout.rdbuf(old_buffer);
+
+    query_outcome outcome;
+    outcome.time_matches = fastest.success == by_time.success
+        && (!fastest.success || fastest.end_arrival_time == by_time.end_arrival_time);
+    outcome.transfers_match = fewest.success == by_transfers.success
+        && (!fewest.success || (fewest.total_vehicle_changes == by_transfers.total_vehicle_changes
+            && fewest.end_arrival_time == by_transfers.end_arrival_time));
+
+    return outcome;
+}
+
+int main(int argc, char* argv[])
+{
+    int hub_count = 40;
+    int query_count = 200;
+    unsigned seed = 1;
+    const char* input_path = "connection_graph.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--hubs") == 0 && i + 1 < argc) {
+            hub_count = std::max(2, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            query_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+    }
+
+    std::vector<graph_edge> edges;
+    if (!read_connection_graph(input_path, edges)) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    hash_stop_ids(edges);
+    astar algorithm(edges);
+    algorithm.preprocess();
+
+    transfer_patterns patterns(algorithm);
+    auto start = std::chrono::steady_clock::now();
+    patterns.precompute(hub_count, FIRST_TIME, LAST_TIME, TIME_STEP);
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Czas wyznaczania wzorcow: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        << ", wzorce: " << patterns.get_pattern_count()
+        << ", wezly: " << patterns.get_node_count() << std::endl;
+
+    std::vector<int> hubs;
+    for (int i = 1; i <= algorithm.get_stop_count(); ++i) {
+        if (patterns.is_hub(i)) {
+            hubs.push_back(i);
+        }
+    }
+
+    std::mt19937 random(seed);
+    int errors = 0;
+    int between_matches = 0;
+
+    for (int query = 0; query < query_count; ++query) {
+        int start_stop_id = hubs[random() % hubs.size()];
+        int end_stop_id = hubs[random() % hubs.size()];
+        if (end_stop_id == start_stop_id) {
+            --query;
+            continue;
+        }
+
+        int slot = random() % ((LAST_TIME - FIRST_TIME) / TIME_STEP + 1);
+        auto on_grid = run_query(algorithm, patterns, start_stop_id, end_stop_id,
+            FIRST_TIME + slot * TIME_STEP);
+        errors += !on_grid.time_matches + !on_grid.transfers_match;
+
+        auto between = run_query(algorithm, patterns, start_stop_id, end_stop_id,
+            FIRST_TIME + slot * TIME_STEP + 1 + random() % (TIME_STEP - 1));
+        between_matches += between.time_matches + between.transfers_match;
+    }
+
+    std::cout << "Zapytania: " << query_count
+        << ", zgodne miedzy chwilami wzorcow: " << between_matches << "/" << 2 * query_count;
+    if (errors) {
+        std::cout << ", BLEDNE W CHWILACH WZORCOW: " << errors << std::endl;
+    }
+    else {
+        std::cout << " OK" << std::endl;
+    }
+
+    bool ok = errors == 0;
+    std::cout << (ok ? "Wszystkie trasy zgodne" : "Trasy niezgodne z pelnym wyszukiwaniem") << std::endl;
+    return ok ? 0 : 1;
+}
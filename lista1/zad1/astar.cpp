@@ -2,24 +2,22 @@
 #include "utils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <barrier>
 #include <cmath>
 #include <cstdint>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <stack>
+#include <thread>
 #include <queue>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 
-static const auto VEHICLE_CHANGE_COST = 1'000'000ULL;
-static enum edge_tuple_idx {
-    DEPARTURE,
-    ARRIVAL,
-    LINE_NAME
-};
-
-
 static inline float astar_get_distance(const graph_edge& edge) {
     return std::sqrt(
         (edge.end_stop_lon - edge.start_stop_lon) * (edge.end_stop_lon - edge.start_stop_lon)
@@ -53,6 +51,154 @@ float astar::get_max_velocity() const
     return velocity;
 }
 
+auto astar::construct_route_patterns(int& ambiguous_joins) const -> std::vector<route_pattern>
+{
+    std::unordered_map<std::string, int> line_ids;
+    std::vector<std::string> line_names;
+    for (const graph_edge& edge : _edges) {
+        if (line_ids.emplace(edge.line, static_cast<int>(line_names.size())).second) {
+            line_names.push_back(edge.line);
+        }
+    }
+
+    std::vector<int> edge_lines(_edges.size());
+    std::vector<int> order(_edges.size());
+    for (int i = 0; i < order.size(); ++i) {
+        edge_lines[i] = line_ids[_edges[i].line];
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&](int first, int second) {
+        return std::make_tuple(_edges[first].departure_time, _edges[first].arrival_time, first)
+            < std::make_tuple(_edges[second].departure_time, _edges[second].arrival_time, second);
+    });
+
+    // A run of zero duration may be continued by another one departing at
+    // the same time, so every block of such runs is put in an order where
+    // each run comes after the run it continues. Runs of a zero duration
+    // cycle keep their order at the end of the block.
+    auto order_zero_duration = [&](std::vector<int>::iterator begin, std::vector<int>::iterator end) {
+        std::map<std::pair<int, int>, int> arriving;
+        for (auto it = begin; it != end; ++it) {
+            ++arriving[std::make_pair(edge_lines[*it], _edges[*it].end_stop_id)];
+        }
+
+        std::deque<int> ready;
+        std::map<std::pair<int, int>, std::vector<int>> blocked;
+        for (auto it = begin; it != end; ++it) {
+            auto key = std::make_pair(edge_lines[*it], _edges[*it].start_stop_id);
+            if (arriving.contains(key)) {
+                blocked[key].push_back(*it);
+            }
+            else {
+                ready.push_back(*it);
+            }
+        }
+
+        std::vector<int> sorted;
+        while (!ready.empty()) {
+            int edge_id = ready.front();
+            ready.pop_front();
+            sorted.push_back(edge_id);
+
+            auto key = std::make_pair(edge_lines[edge_id], _edges[edge_id].end_stop_id);
+            if (--arriving[key] == 0) {
+                auto it = blocked.find(key);
+                if (it != blocked.end()) {
+                    ready.insert(ready.end(), it->second.begin(), it->second.end());
+                    blocked.erase(it);
+                }
+            }
+        }
+
+        // The block is sorted by edge id, which restores the order of the rest
+        std::vector<int> cycles;
+        for (auto& [key, edge_ids] : blocked) {
+            cycles.insert(cycles.end(), edge_ids.begin(), edge_ids.end());
+        }
+
+        std::sort(cycles.begin(), cycles.end());
+        sorted.insert(sorted.end(), cycles.begin(), cycles.end());
+        std::copy(sorted.begin(), sorted.end(), begin);
+    };
+
+    for (auto begin = order.begin(); begin != order.end();) {
+        int time = _edges[*begin].departure_time;
+        auto end = begin;
+        while (end != order.end() && _edges[*end].departure_time == time && _edges[*end].arrival_time == time) {
+            ++end;
+        }
+
+        if (end - begin > 1) {
+            order_zero_duration(begin, end);
+        }
+
+        begin = end == begin ? begin + 1 : end;
+    }
+
+    // A run continues a trip of the same line that arrived at its start stop
+    // exactly at its departure time. Trips waiting for their next run are
+    // keyed by (line, stop, time). Without trip ids, trips of a line meeting
+    // at a stop at the same time cannot be told apart: the last one to
+    // arrive is continued and the join is counted as ambiguous.
+    ambiguous_joins = 0;
+    std::vector<std::vector<int>> trips;
+    std::map<std::tuple<int, int, int>, std::vector<int>> waiting_trips;
+    for (int edge_id : order) {
+        const graph_edge& edge = _edges[edge_id];
+        int line_id = edge_lines[edge_id];
+        int trip_id;
+
+        auto it = waiting_trips.find(std::make_tuple(line_id, edge.start_stop_id, edge.departure_time));
+        if (it != waiting_trips.end() && !it->second.empty()) {
+            ambiguous_joins += it->second.size() > 1;
+            trip_id = it->second.back();
+            it->second.pop_back();
+        }
+        else {
+            trip_id = static_cast<int>(trips.size());
+            trips.emplace_back();
+        }
+
+        trips[trip_id].push_back(edge_id);
+        waiting_trips[std::make_tuple(line_id, edge.end_stop_id, edge.arrival_time)].push_back(trip_id);
+    }
+
+    std::vector<route_pattern> patterns;
+    std::map<std::tuple<int, std::vector<int>, std::vector<int>>, int> pattern_ids;
+    for (auto& trip : trips) {
+        int line_id = line_ids[_edges[trip.front()].line];
+        int start_time = _edges[trip.front()].departure_time;
+        std::vector<int> stops = { _edges[trip.front()].start_stop_id };
+        std::vector<int> offsets = { 0 };
+
+        for (int edge_id : trip) {
+            stops.push_back(_edges[edge_id].end_stop_id);
+            offsets.push_back(_edges[edge_id].arrival_time - start_time);
+        }
+
+        auto [it, inserted] = pattern_ids.emplace(
+            std::make_tuple(line_id, std::move(stops), std::move(offsets)),
+            static_cast<int>(patterns.size()));
+
+        if (inserted) {
+            patterns.push_back({
+                .line = line_names[line_id],
+                .stops = std::get<1>(it->first),
+                .offsets = std::get<2>(it->first),
+                });
+        }
+
+        patterns[it->second].trip_starts.push_back(start_time);
+    }
+
+    for (route_pattern& pattern : patterns) {
+        std::sort(pattern.trip_starts.begin(), pattern.trip_starts.end());
+    }
+
+    return patterns;
+}
+
 auto astar::construct_node_info(int node_max_id) -> std::vector<node_info>
 {
     std::vector<node_info> nodes;
@@ -70,38 +216,68 @@ auto astar::construct_node_info(int node_max_id) -> std::vector<node_info>
             nodes[edge.end_stop_id].lon = edge.end_stop_lon;
             nodes[edge.end_stop_id].lat = edge.end_stop_lat;
         }
+    }
 
-        bool found_neighbor = false;
-        for (auto& neighbor : nodes[edge.start_stop_id].neighbors) {
-            if (neighbor.destination == edge.end_stop_id) {
-                neighbor.times.push_back(std::make_tuple(
-                    edge.departure_time, edge.arrival_time, edge.line));
-                found_neighbor = true;
-                break;
+    for (int pattern_id = 0; pattern_id < _patterns.size(); ++pattern_id) {
+        const route_pattern& pattern = _patterns[pattern_id];
+
+        for (int i = 0; i + 1 < pattern.stops.size(); ++i) {
+            pattern_hop hop = { .pattern = pattern_id, .index = i };
+            auto& neighbors = nodes[pattern.stops[i]].neighbors;
+            nodes[pattern.stops[i]].patterns.push_back(hop);
+
+            bool found_neighbor = false;
+            for (auto& neighbor : neighbors) {
+                if (neighbor.destination == pattern.stops[i + 1]) {
+                    neighbor.hops.push_back(hop);
+                    found_neighbor = true;
+                    break;
+                }
             }
-        }
 
-        if (!found_neighbor) {
-            nodes[edge.start_stop_id].neighbors.push_back({
-                .destination = edge.end_stop_id,
-                .times = { std::make_tuple(
-                    edge.departure_time, edge.arrival_time, edge.line) },
-                });
+            if (!found_neighbor) {
+                neighbors.push_back({
+                    .destination = pattern.stops[i + 1],
+                    .hops = { hop },
+                    });
+            }
         }
     }
 
     for (node_info& info : nodes) {
         info.total_cost = info.current_cost = info.estimated_cost = 0;
-        info.previous_edge = nullptr;
+        info.previous_edge = trip_ref{};
         info.previous_node = 0;
         info.veh_change_count = 0;
+    }
+
+    return nodes;
+}
 
-        for (auto& neighbor_info : info.neighbors) {
-            std::sort(neighbor_info.times.begin(), neighbor_info.times.end());
+int astar::construct_line_states()
+{
+    std::unordered_map<std::string, int> line_ids;
+    std::unordered_map<std::uint64_t, int> state_ids;
+    _line_names.clear();
+
+    for (route_pattern& pattern : _patterns) {
+        auto [line_it, inserted] = line_ids.emplace(pattern.line, static_cast<int>(_line_names.size()));
+        if (inserted) {
+            _line_names.push_back(pattern.line);
+        }
+
+        int line_id = line_it->second;
+        pattern.line_id = line_id;
+        pattern.states.clear();
+
+        for (int stop_id : pattern.stops) {
+            std::uint64_t key = (static_cast<std::uint64_t>(line_id) << 32) | static_cast<std::uint32_t>(stop_id);
+            pattern.states.push_back(
+                state_ids.emplace(key, static_cast<int>(state_ids.size())).first->second);
         }
     }
 
-    return nodes;
+    return static_cast<int>(state_ids.size());
 }
 
 std::uint64_t astar::compute_heuristics(node_info& current, node_info& destination) const
@@ -114,86 +290,139 @@ std::uint64_t astar::compute_heuristics(node_info& current, node_info& destinati
     return static_cast<std::uint64_t>(distance / _max_velocity);
 }
 
-auto astar::travel_cost(bool optimize_time, node_info& current, timetable_edge& next,
-    const std::string& current_line) const -> std::tuple<std::uint64_t, single_edge*, bool>
+auto astar::travel_cost(node_info& current, timetable_edge& next,
+    const std::string& current_line) const -> std::tuple<std::uint64_t, trip_ref, bool>
 {
     int current_time = current.current_cost;
     if (current.previous_edge) {
-        current_time = std::get<ARRIVAL>(*current.previous_edge);
+        current_time = arrival_of(current.previous_edge);
     }
 
-    int vehicle_change_cost = optimize_time ? 1 : VEHICLE_CHANGE_COST;
+    trip_ref run = first_run(next, current_time);
+    if (!run) {
+        return { current_time + 24 * 60 * 60, trip_ref{}, false };
+    }
 
-    // Perform bin-search to find nearest departure time
-    int start = 0;
-    int end = next.times.size();
+    // Every vehicle change costs a second, so that of equally fast routes
+    // the one with fewer changes wins
+    int new_veh_change_count = current.veh_change_count;
+    bool veh_changed = false;
 
-    while (start < end) {
-        int center = (start + end) / 2;
-        int center_time = std::get<DEPARTURE>(next.times[center]);
+    if (line_of(run) != current_line) {
+        trip_ref same_line_run = first_run(next, current_time, &current_line);
 
-        if (center_time < current_time) {
-            start = center + 1;
-        }
-        else if (center_time >= current_time) {
-            end = center;
+        // Stay on the line as long as it arrives as early
+        if (same_line_run && departure_of(same_line_run) == departure_of(run)
+            && arrival_of(same_line_run) == arrival_of(run)) {
+            return { arrival_of(same_line_run) + new_veh_change_count, same_line_run, false };
         }
+
+        ++new_veh_change_count;
+        veh_changed = true;
     }
 
+    return { arrival_of(run) + new_veh_change_count, run, veh_changed };
+}
 
-    if (end < next.times.size()) {
-        int departure_time = std::get<DEPARTURE>(next.times[end]);
-        int arrival_time = std::get<ARRIVAL>(next.times[end]);
-        int new_veh_change_count = current.veh_change_count;
-        bool veh_changed = false;
+auto astar::first_trip(const pattern_hop& hop, int current_time) const -> trip_ref
+{
+    const route_pattern& pattern = _patterns[hop.pattern];
 
-        if (std::get<LINE_NAME>(next.times[end]) != current_line) {
-            for (int i = end + 1; i < next.times.size(); ++i) {
-                int this_departure_time = std::get<DEPARTURE>(next.times[i]);
-                int this_arrival_time = std::get<ARRIVAL>(next.times[i]);
+    // All trips of a pattern keep the same offsets, so the first trip
+    // departing late enough is also the one arriving first
+    auto it = std::lower_bound(pattern.trip_starts.begin(), pattern.trip_starts.end(),
+        current_time - pattern.offsets[hop.index]);
 
-                if (optimize_time) {
-                    // For optimize_time, we always want to have the best arrival time
-                    if (this_departure_time != departure_time || this_arrival_time != arrival_time) {
-                        break;
-                    }
-                }
-                else {
-                    // For disabled optimize_time, we may want to have a little
-                    // worse arrival time, but still do not change lines
-                    // (assuming that a single stop arrival_time == departure_time)
-
-                    // Ignore this check for the very first node, to allow
-                    // the chosen first line to "spread"
-                    if (current.previous_edge != nullptr && this_departure_time != departure_time) {
-                        break;
-                    }
-                }
+    if (it == pattern.trip_starts.end()) {
+        return trip_ref{};
+    }
 
-                if (std::get<LINE_NAME>(next.times[i]) == current_line) {
-                    return {
-                        std::get<ARRIVAL>(next.times[i]) + new_veh_change_count * vehicle_change_cost,
-                        &next.times[i], false
-                    };
-                }
-            }
+    return {
+        .pattern = hop.pattern,
+        .trip = static_cast<int>(it - pattern.trip_starts.begin()),
+        .index = hop.index,
+    };
+}
+
+auto astar::first_run(const timetable_edge& next, int current_time,
+    const std::string* line) const -> trip_ref
+{
+    trip_ref best;
+
+    for (const pattern_hop& hop : next.hops) {
+        if (line && _patterns[hop.pattern].line != *line) {
+            continue;
+        }
 
-            ++new_veh_change_count;
-            veh_changed = true;
+        trip_ref run = first_trip(hop, current_time);
+        if (run && (!best || run_before(run, best))) {
+            best = run;
         }
+    }
+
+    return best;
+}
+
+bool astar::run_before(const trip_ref& first, const trip_ref& second) const
+{
+    int first_departure = departure_of(first), second_departure = departure_of(second);
+    if (first_departure != second_departure) {
+        return first_departure < second_departure;
+    }
+
+    int first_arrival = arrival_of(first), second_arrival = arrival_of(second);
+    if (first_arrival != second_arrival) {
+        return first_arrival < second_arrival;
+    }
+
+    return line_of(first) < line_of(second);
+}
+
+int astar::departure_of(const trip_ref& run) const
+{
+    const route_pattern& pattern = _patterns[run.pattern];
+    return pattern.trip_starts[run.trip] + pattern.offsets[run.index];
+}
+
+int astar::arrival_of(const trip_ref& run) const
+{
+    const route_pattern& pattern = _patterns[run.pattern];
+    return pattern.trip_starts[run.trip] + pattern.offsets[run.index + 1];
+}
+
+const std::string& astar::line_of(const trip_ref& run) const
+{
+    return _patterns[run.pattern].line;
+}
+
+std::size_t astar::timetable_size() const
+{
+    std::size_t size = _patterns.capacity() * sizeof(route_pattern);
 
-        return {
-            std::get<ARRIVAL>(next.times[end]) + new_veh_change_count * vehicle_change_cost,
-            &next.times[end], veh_changed
-        };
+    for (const route_pattern& pattern : _patterns) {
+        size += pattern.stops.capacity() * sizeof(int)
+            + pattern.offsets.capacity() * sizeof(int)
+            + pattern.trip_starts.capacity() * sizeof(int)
+            + pattern.states.capacity() * sizeof(int);
     }
-    else
-        return { current_time + 24 * 60 * 60, nullptr, false };
+
+    for (const node_info& info : _nodes) {
+        size += info.neighbors.capacity() * sizeof(timetable_edge)
+            + info.patterns.capacity() * sizeof(pattern_hop);
+
+        for (const timetable_edge& neighbor : info.neighbors) {
+            size += neighbor.hops.capacity() * sizeof(pattern_hop);
+        }
+    }
+
+    return size;
 }
 
 astar::astar(const std::vector<graph_edge>& edges)
     : _edges(edges)
     , _max_velocity(0.f)
+    , _ambiguous_joins(0)
+    , _line_state_count(0)
 {
 }
 
@@ -203,7 +432,37 @@ void astar::preprocess()
     int node_max_id = get_max_node_id();
     float velocity = get_max_velocity();
 
+    _patterns = construct_route_patterns(_ambiguous_joins);
     _nodes = construct_node_info(node_max_id);
+    _line_state_count = construct_line_states();
+
+    std::vector<std::string> stop_names;
+    for (const node_info& info : _nodes) {
+        stop_names.push_back(info.stop_name);
+    }
+    _stop_index.build(stop_names);
+
+    // What the timetable used to take with a (departure, arrival, line)
+    // tuple stored for every single run
+    std::size_t run_table_size = _edges.size() * sizeof(std::tuple<int, int, std::string>);
+    for (const node_info& info : _nodes) {
+        std::size_t neighbors = info.neighbors.size();
+        run_table_size += neighbors * (sizeof(int) + sizeof(std::vector<int>));
+    }
+
+    std::size_t trip_count = 0;
+    for (const route_pattern& pattern : _patterns) {
+        trip_count += pattern.trip_starts.size();
+    }
+
+    std::cout << "Kursy: " << trip_count << ", wzorce tras: " << _patterns.size()
+        << ", rozklad: " << (timetable_size() / 1024) << " kB zamiast "
+        << (run_table_size / 1024) << " kB" << std::endl;
+
+    if (_ambiguous_joins > 0) {
+        std::cout << "Uwaga: kursy tej samej linii spotykaja sie na przystanku o tej samej porze "
+            << _ambiguous_joins << " razy, ich polaczenie w kursy jest zgadywane" << std::endl;
+    }
 }
 
 void astar::output_stop_names()
@@ -215,6 +474,31 @@ void astar::output_stop_names()
     }
 }
 
+int astar::get_stop_count() const
+{
+    return static_cast<int>(_nodes.size()) - 1;
+}
+
+int astar::get_ambiguous_join_count() const
+{
+    return _ambiguous_joins;
+}
+
+const std::string& astar::get_stop_name(int stop_id) const
+{
+    return _nodes[stop_id].stop_name;
+}
+
+const std::string& astar::get_line_name(int line_id) const
+{
+    return _line_names[line_id];
+}
+
+const stop_index& astar::get_stop_index() const
+{
+    return _stop_index;
+}
+
 std::unordered_set<std::string> astar::get_lines_at_stop(int stop_id) const
 {
     std::unordered_set<std::string> out;
@@ -222,8 +506,8 @@ std::unordered_set<std::string> astar::get_lines_at_stop(int stop_id) const
         return out;
 
     for (auto& neighbor : _nodes[stop_id].neighbors) {
-        for (auto& time : neighbor.times) {
-            out.insert(std::get<LINE_NAME>(time));
+        for (auto& hop : neighbor.hops) {
+            out.insert(_patterns[hop.pattern].line);
         }
     }
     return out;
@@ -251,7 +535,7 @@ auto astar::compute_dijkstra(int start_stop_id, int end_stop_id,
     _nodes[start_stop_id].estimated_cost = 0;
     _nodes[start_stop_id].total_cost
         = _nodes[start_stop_id].current_cost + _nodes[start_stop_id].estimated_cost;
-    _nodes[start_stop_id].previous_edge = nullptr;
+    _nodes[start_stop_id].previous_edge = trip_ref{};
     _nodes[start_stop_id].previous_node = 0;
     _nodes[start_stop_id].veh_change_count = 0;
 
@@ -265,7 +549,7 @@ auto astar::compute_dijkstra(int start_stop_id, int end_stop_id,
 
         if (node_id == end_stop_id) {
             std::cout << "Znaleziono rozwiazanie: "
-                << time_to_str(std::get<ARRIVAL>(*_nodes[end_stop_id].previous_edge))
+                << time_to_str(arrival_of(_nodes[end_stop_id].previous_edge))
                 << ", przesiadki: " << (_nodes[end_stop_id].veh_change_count - 1)
                 << std::endl;
             found_solution = true;
@@ -280,11 +564,11 @@ auto astar::compute_dijkstra(int start_stop_id, int end_stop_id,
 
             std::string current_line = "";
             if (_nodes[node_id].previous_edge) {
-                current_line = std::get<LINE_NAME>(*_nodes[node_id].previous_edge);
+                current_line = line_of(_nodes[node_id].previous_edge);
             }
 
             auto&& [travel_cost, edge_ptr, vehicle_change]
-                = this->travel_cost(true, _nodes[node_id], neighbor, current_line);
+                = this->travel_cost(_nodes[node_id], neighbor, current_line);
 
             bool better_route_found = _nodes[next_node_id].current_cost > travel_cost;
             if (edge_ptr && better_route_found) {
@@ -305,11 +589,11 @@ auto astar::compute_dijkstra(int start_stop_id, int end_stop_id,
         return result;
     }
 
-    return construct_result(start_stop_id, end_stop_id, true, start_stop_time);
+    return construct_result(start_stop_id, end_stop_id, start_stop_time);
 }
 
 auto astar::compute(int start_stop_id, int end_stop_id,
-    bool optimize_time, int start_stop_time, std::string start_line) -> result
+    int start_stop_time) -> result
 {
     result result;
     result.success = false;
@@ -326,7 +610,7 @@ auto astar::compute(int start_stop_id, int end_stop_id,
     _nodes[start_stop_id].estimated_cost = 0;
     _nodes[start_stop_id].total_cost
         = _nodes[start_stop_id].current_cost + _nodes[start_stop_id].estimated_cost;
-    _nodes[start_stop_id].previous_edge = nullptr;
+    _nodes[start_stop_id].previous_edge = trip_ref{};
     _nodes[start_stop_id].previous_node = 0;
     _nodes[start_stop_id].veh_change_count = 0;
 
@@ -341,8 +625,8 @@ auto astar::compute(int start_stop_id, int end_stop_id,
         auto [_, node_id] = open_nodes.top();
         if (node_id == end_stop_id) {
             std::cout << "Znaleziono rozwiazanie: "
-                << time_to_str(std::get<ARRIVAL>(*_nodes[end_stop_id].previous_edge))
-                << ", przesiadki: " << (_nodes[end_stop_id].veh_change_count - optimize_time)
+                << time_to_str(arrival_of(_nodes[end_stop_id].previous_edge))
+                << ", przesiadki: " << (_nodes[end_stop_id].veh_change_count - 1)
                 << std::endl;
             found_solution = true;
         }
@@ -354,13 +638,13 @@ auto astar::compute(int start_stop_id, int end_stop_id,
         for (auto& neighbor : _nodes[node_id].neighbors) {
             int next_node_id = neighbor.destination;
             if (!open_nodes_set.contains(next_node_id) && !closed_nodes.contains(next_node_id)) {
-                std::string current_line = start_line;
+                std::string current_line = "";
                 if (_nodes[node_id].previous_edge) {
-                    current_line = std::get<LINE_NAME>(*_nodes[node_id].previous_edge);
+                    current_line = line_of(_nodes[node_id].previous_edge);
                 }
 
                 auto&& [travel_cost, edge_ptr, vehicle_change]
-                    = this->travel_cost(optimize_time, _nodes[node_id], neighbor, current_line);
+                    = this->travel_cost(_nodes[node_id], neighbor, current_line);
 
                 if (edge_ptr) {
                     _nodes[next_node_id].estimated_cost
@@ -378,24 +662,15 @@ auto astar::compute(int start_stop_id, int end_stop_id,
                 }
             }
             else {
-                std::string current_line = start_line;
+                std::string current_line = "";
                 if (_nodes[node_id].previous_edge) {
-                    current_line = std::get<LINE_NAME>(*_nodes[node_id].previous_edge);
+                    current_line = line_of(_nodes[node_id].previous_edge);
                 }
 
                 auto&& [travel_cost, edge_ptr, vehicle_change]
-                    = this->travel_cost(optimize_time, _nodes[node_id], neighbor, current_line);
+                    = this->travel_cost(_nodes[node_id], neighbor, current_line);
                 bool better_route_found = _nodes[next_node_id].current_cost > travel_cost;
 
-                // This is required to preserve consistence - to update cost,
-                // there must be a route that contains smaller number of vehicle
-                // changes. Otherwise, a line that arrives at this stop
-                // a little earlier may be introduced, increasing a total number of
-                // vehicle changes (A* has no clue about this behavior).
-                if (!optimize_time) {
-                    better_route_found = _nodes[next_node_id].current_cost > travel_cost + 86400;
-                }
-
                 if (edge_ptr && better_route_found) {
                     _nodes[next_node_id].current_cost = travel_cost;
                     _nodes[next_node_id].total_cost
@@ -420,11 +695,608 @@ auto astar::compute(int start_stop_id, int end_stop_id,
         return result;
     }
 
-    return construct_result(start_stop_id, end_stop_id, optimize_time, start_stop_time);
+    return construct_result(start_stop_id, end_stop_id, start_stop_time);
+}
+
+auto astar::compute_fewest_transfers(int start_stop_id, int end_stop_id,
+    int start_stop_time) const -> result
+{
+    result result;
+    result.success = false;
+
+    if (start_stop_id <= 0 || start_stop_id >= _nodes.size()
+        || end_stop_id <= 0 || end_stop_id >= _nodes.size()
+        || start_stop_id == end_stop_id) {
+
+        return result;
+    }
+
+    std::cout << "Uruchamianie wyszukiwania z najmniejsza liczba przesiadek..." << std::endl;
+
+    std::vector<transfer_label> labels;
+    std::vector<int> settled;
+    int end_label = search_transfers(start_stop_id, start_stop_time, end_stop_id, labels, settled);
+
+    if (end_label < 0) {
+        return result;
+    }
+
+    std::vector<int> route;
+    for (int label_id = end_label; label_id >= 0; label_id = labels[label_id].previous) {
+        route.push_back(label_id);
+    }
+
+    std::reverse(route.begin(), route.end());
+
+    // Consecutive rides of the same line make a single stage
+    for (int label_id : route) {
+        const transfer_label& label = labels[label_id];
+        const route_pattern& pattern = _patterns[label.ride.pattern];
+
+        if (result.stages.empty() || result.stages.back().line != pattern.line) {
+            result.stages.push_back({
+                .line = pattern.line,
+                .start_stop = _nodes[pattern.stops[label.ride.index]].stop_name,
+                .onboard_time = departure_of(label.ride),
+                });
+        }
+
+        result.stages.back().end_stop = _nodes[pattern.stops[label.alight_index]].stop_name;
+        result.stages.back().offboard_time = label.arrival;
+    }
+
+    result.success = true;
+    result.start_stop = _nodes[start_stop_id].stop_name;
+    result.end_stop = _nodes[end_stop_id].stop_name;
+    result.start_stop_time = start_stop_time;
+    result.end_arrival_time = labels[end_label].arrival;
+    result.total_vehicle_changes = labels[end_label].transfers;
+    result.total_cost = result.end_arrival_time;
+
+    std::cout << "Znaleziono rozwiazanie: "
+        << time_to_str(result.end_arrival_time)
+        << ", przesiadki: " << result.total_vehicle_changes
+        << std::endl;
+
+    return result;
+}
+
+int astar::search_transfers(int start_stop_id, int start_stop_time, int end_stop_id,
+    std::vector<transfer_label>& labels, std::vector<int>& settled) const
+{
+    // Staying on the line is free and boarding any other one costs a transfer.
+    // Buckets indexed by the transfer count are drained in order, each one in
+    // order of arrival, so the first label settled at the end stop is the
+    // best one. With no end stop the search runs until the buckets are empty.
+    // A state is settled in a later bucket only if it arrives strictly
+    // earlier than in all earlier ones, so no label is expanded twice.
+    static const int UNREACHED = std::numeric_limits<int>::max();
+
+    labels.clear();
+    settled.clear();
+
+    std::vector<std::priority_queue<std::pair<int, int>>> buckets(1);
+    std::vector<int> arrivals(_line_state_count, UNREACHED);
+
+    // Earliest label queued in the current and in the next bucket
+    std::vector<int> queued[2] = {
+        std::vector<int>(_line_state_count, UNREACHED),
+        std::vector<int>(_line_state_count, UNREACHED),
+    };
+
+    // Board the first catchable trip of every pattern serving the stop and
+    // ride it, as in compute_ride_tree(). Once the ride reaches a state that
+    // is reached no later with no more transfers, that state covers the rest
+    // of the ride.
+    auto expand = [&](int stop_id, int time, int state, int transfers, int previous) {
+        for (auto& hop : _nodes[stop_id].patterns) {
+            trip_ref trip = first_trip(hop, time);
+            if (!trip) {
+                continue;
+            }
+
+            const route_pattern& pattern = _patterns[hop.pattern];
+            int bucket = transfers + (state >= 0 && pattern.states[hop.index] != state);
+            int trip_start = pattern.trip_starts[trip.trip];
+            auto& bucket_arrivals = queued[bucket & 1];
+
+            if (bucket == buckets.size()) {
+                buckets.emplace_back();
+            }
+
+            for (int i = hop.index + 1; i < pattern.stops.size(); ++i) {
+                int next_state = pattern.states[i];
+                int arrival_time = trip_start + pattern.offsets[i];
+
+                if (std::min(arrivals[next_state], bucket_arrivals[next_state]) <= arrival_time) {
+                    break;
+                }
+
+                bucket_arrivals[next_state] = arrival_time;
+                buckets[bucket].emplace(-arrival_time, static_cast<int>(labels.size()));
+                labels.push_back({
+                    .state = next_state,
+                    .arrival = arrival_time,
+                    .transfers = bucket,
+                    .previous = previous,
+                    .ride = trip,
+                    .alight_index = i,
+                    });
+            }
+        }
+    };
+
+    expand(start_stop_id, start_stop_time, -1, 0, -1);
+
+    int end_label = -1;
+    for (int bucket = 0; bucket < buckets.size() && end_label < 0; ++bucket) {
+        while (!buckets[bucket].empty()) {
+            int label_id = buckets[bucket].top().second;
+            buckets[bucket].pop();
+
+            transfer_label label = labels[label_id];
+            if (arrivals[label.state] <= label.arrival) {
+                continue;
+            }
+
+            arrivals[label.state] = label.arrival;
+            settled.push_back(label_id);
+
+            int stop_id = _patterns[label.ride.pattern].stops[label.alight_index];
+            if (stop_id == end_stop_id) {
+                end_label = label_id;
+                break;
+            }
+
+            expand(stop_id, label.arrival, label.state, bucket, label_id);
+        }
+
+        // Becomes the bucket after the next one
+        std::fill(queued[bucket & 1].begin(), queued[bucket & 1].end(), UNREACHED);
+    }
+
+    return end_label;
+}
+
+auto astar::compute_transfer_tree(int start_stop_id, int start_stop_time) const -> transfer_tree
+{
+    transfer_tree tree;
+    tree.start_stop_time = start_stop_time;
+    tree.stop_labels.assign(_nodes.size(), {});
+
+    if (start_stop_id <= 0 || start_stop_id >= _nodes.size()) {
+        return tree;
+    }
+
+    std::vector<transfer_label> labels;
+    std::vector<int> settled;
+    search_transfers(start_stop_id, start_stop_time, 0, labels, settled);
+
+    // Labels are settled by transfers and then by arrival, so a label joins
+    // the front of its stop only if it beats the last one already there
+    std::vector<int> tree_ids(labels.size(), -1);
+    for (int label_id : settled) {
+        const transfer_label& label = labels[label_id];
+        const route_pattern& pattern = _patterns[label.ride.pattern];
+        int stop_id = pattern.stops[label.alight_index];
+
+        tree_ids[label_id] = static_cast<int>(tree.labels.size());
+        tree.labels.push_back({
+            .stop_id = stop_id,
+            .arrival_time = label.arrival,
+            .transfers = label.transfers,
+            .previous = label.previous >= 0 ? tree_ids[label.previous] : -1,
+            .boarding_stop_id = pattern.stops[label.ride.index],
+            .line_id = pattern.line_id,
+            });
+
+        auto& front = tree.stop_labels[stop_id];
+        if (front.empty() || label.arrival < tree.labels[front.back()].arrival_time) {
+            front.push_back(tree_ids[label_id]);
+        }
+    }
+
+    return tree;
+}
+
+auto astar::compute_reachability(int start_stop_id, int start_stop_time,
+    int time_budget) const -> reachability
+{
+    return compute_reachability(std::vector<int>{ start_stop_id }, start_stop_time, time_budget);
+}
+
+auto astar::compute_reachability(const std::vector<int>& start_stop_ids,
+    int start_stop_time, int time_budget) const -> reachability
+{
+    reachability map;
+    map.start_stop_time = start_stop_time;
+    map.time_budget = time_budget;
+    map.reached_count = 0;
+    map.arrival_times.assign(_nodes.size(), -1);
+    map.source_stop_ids.assign(_nodes.size(), -1);
+
+    int time_limit = start_stop_time + time_budget;
+
+    // All sources share a single pass, every stop keeps the source it was
+    // reached from first
+    std::priority_queue<std::pair<int, int>> open_nodes;
+    for (int start_stop_id : start_stop_ids) {
+        if (start_stop_id <= 0 || start_stop_id >= _nodes.size()
+            || map.arrival_times[start_stop_id] >= 0) {
+            continue;
+        }
+
+        map.arrival_times[start_stop_id] = start_stop_time;
+        map.source_stop_ids[start_stop_id] = start_stop_id;
+        open_nodes.push(std::make_pair(-start_stop_time, start_stop_id));
+    }
+
+    while (!open_nodes.empty()) {
+        auto [pq_cost, node_id] = open_nodes.top();
+        open_nodes.pop();
+
+        if (-pq_cost != map.arrival_times[node_id]) {
+            continue;
+        }
+
+        ++map.reached_count;
+
+        // Board the first catchable trip of every pattern serving this stop
+        // and ride it. Once the ride reaches a stop that is already reached
+        // no later, the rest of the ride is covered from that stop.
+        for (auto& hop : _nodes[node_id].patterns) {
+            trip_ref trip = first_trip(hop, -pq_cost);
+            if (!trip) {
+                continue;
+            }
+
+            const route_pattern& pattern = _patterns[hop.pattern];
+            int trip_start = pattern.trip_starts[trip.trip];
+
+            for (int i = hop.index + 1; i < pattern.stops.size(); ++i) {
+                int next_node_id = pattern.stops[i];
+                int arrival_time = trip_start + pattern.offsets[i];
+
+                if (arrival_time > time_limit
+                    || (map.arrival_times[next_node_id] >= 0
+                        && map.arrival_times[next_node_id] <= arrival_time)) {
+                    break;
+                }
+
+                map.arrival_times[next_node_id] = arrival_time;
+                map.source_stop_ids[next_node_id] = map.source_stop_ids[node_id];
+                open_nodes.emplace(std::make_pair(-arrival_time, next_node_id));
+            }
+        }
+    }
+
+    return map;
+}
+
+auto astar::compute_reachability_parallel(const std::vector<int>& start_stop_ids,
+    int start_stop_time, int time_budget, int thread_count, int delta) const -> reachability
+{
+    return std::move(compute_reachability_parallel(std::vector<std::vector<int>>{ start_stop_ids },
+        start_stop_time, time_budget, thread_count, delta).front());
+}
+
+auto astar::compute_reachability_parallel(const std::vector<std::vector<int>>& start_stop_id_sets,
+    int start_stop_time, int time_budget, int thread_count, int delta) const -> std::vector<reachability>
+{
+    // Delta-stepping: stops are kept in buckets of width `delta` seconds.
+    // A bucket is drained in phases, every phase relaxes the whole bucket
+    // in parallel and may refill it (or any later bucket), until it stays empty.
+    // Arrival time and source stop are packed into a single 64-bit word,
+    // so a label is always updated with one compare-and-swap. The threads
+    // are started once and solve the source sets one after another.
+    static const std::uint64_t UNREACHED = -1ULL;
+    static const int CHUNK_SIZE = 32;
+
+    std::vector<reachability> maps(start_stop_id_sets.size());
+    if (maps.empty()) {
+        return maps;
+    }
+
+    int time_limit = start_stop_time + time_budget;
+    thread_count = std::max(thread_count, 1);
+    delta = std::max(delta, 1);
+
+    auto pack = [](int arrival_time, int source) -> std::uint64_t {
+        return (static_cast<std::uint64_t>(arrival_time) << 32) | static_cast<std::uint32_t>(source);
+    };
+    auto bucket_of = [&](int arrival_time) { return (arrival_time - start_stop_time) / delta; };
+
+    std::vector<std::atomic<std::uint64_t>> labels(_nodes.size());
+    std::vector<std::vector<int>> buckets(time_budget / delta + 1);
+
+    // Every thread collects the stops it improved as (bucket, stop) pairs,
+    // they are merged into the buckets between the phases
+    std::vector<std::vector<std::pair<int, int>>> pending(thread_count);
+    std::vector<int> frontier;
+    std::atomic<std::size_t> cursor = 0;
+    int current_bucket = static_cast<int>(buckets.size());
+    int current_set = -1;
+    bool done = false;
+
+    auto start_set = [&]() {
+        for (auto& label : labels) {
+            label.store(UNREACHED, std::memory_order_relaxed);
+        }
+
+        for (int start_stop_id : start_stop_id_sets[current_set]) {
+            if (start_stop_id <= 0 || start_stop_id >= _nodes.size()
+                || labels[start_stop_id].load(std::memory_order_relaxed) != UNREACHED) {
+                continue;
+            }
+
+            labels[start_stop_id].store(pack(start_stop_time, start_stop_id), std::memory_order_relaxed);
+            buckets[0].push_back(start_stop_id);
+        }
+
+        current_bucket = 0;
+    };
+
+    auto finish_set = [&]() {
+        reachability& map = maps[current_set];
+        map.start_stop_time = start_stop_time;
+        map.time_budget = time_budget;
+        map.reached_count = 0;
+        map.arrival_times.assign(_nodes.size(), -1);
+        map.source_stop_ids.assign(_nodes.size(), -1);
+
+        for (int i = 0; i < _nodes.size(); ++i) {
+            std::uint64_t label = labels[i].load(std::memory_order_relaxed);
+            if (label == UNREACHED) {
+                continue;
+            }
+
+            map.arrival_times[i] = static_cast<int>(label >> 32);
+            map.source_stop_ids[i] = static_cast<int>(label & 0xFFFFFFFF);
+            ++map.reached_count;
+        }
+    };
+
+    auto next_phase = [&]() noexcept {
+        for (auto& thread_pending : pending) {
+            for (auto [bucket, node_id] : thread_pending) {
+                buckets[bucket].push_back(node_id);
+            }
+            thread_pending.clear();
+        }
+
+        while (current_bucket < buckets.size() && buckets[current_bucket].empty()) {
+            ++current_bucket;
+        }
+
+        // Once the last bucket runs dry the next source set starts
+        while (current_bucket == buckets.size()) {
+            if (current_set >= 0) {
+                finish_set();
+            }
+
+            if (++current_set == maps.size()) {
+                frontier.clear();
+                done = true;
+                return;
+            }
+
+            start_set();
+            while (current_bucket < buckets.size() && buckets[current_bucket].empty()) {
+                ++current_bucket;
+            }
+        }
+
+        frontier.clear();
+        frontier.swap(buckets[current_bucket]);
+        std::sort(frontier.begin(), frontier.end());
+        frontier.erase(std::unique(frontier.begin(), frontier.end()), frontier.end());
+        cursor.store(0, std::memory_order_relaxed);
+    };
+
+    std::barrier phase_barrier(thread_count, next_phase);
+    next_phase();
+
+    auto worker = [&](int thread_id) {
+        auto& out = pending[thread_id];
+
+        while (!done) {
+            // Threads pull chunks of the current bucket until it runs dry,
+            // so a thread stuck on a busy stop does not hold back the others
+            std::size_t begin;
+            while ((begin = cursor.fetch_add(CHUNK_SIZE, std::memory_order_relaxed)) < frontier.size()) {
+                std::size_t end = std::min(begin + CHUNK_SIZE, frontier.size());
+
+                for (std::size_t i = begin; i < end; ++i) {
+                    int node_id = frontier[i];
+                    std::uint64_t label = labels[node_id].load(std::memory_order_relaxed);
+                    int current_time = static_cast<int>(label >> 32);
+                    int source = static_cast<int>(label & 0xFFFFFFFF);
+
+                    // Stop has been improved into an earlier bucket in the meantime
+                    if (bucket_of(current_time) != current_bucket) {
+                        continue;
+                    }
+
+                    for (auto& hop : _nodes[node_id].patterns) {
+                        trip_ref trip = first_trip(hop, current_time);
+                        if (!trip) {
+                            continue;
+                        }
+
+                        const route_pattern& pattern = _patterns[hop.pattern];
+                        int trip_start = pattern.trip_starts[trip.trip];
+
+                        for (int j = hop.index + 1; j < pattern.stops.size(); ++j) {
+                            int next_node_id = pattern.stops[j];
+                            int arrival_time = trip_start + pattern.offsets[j];
+                            if (arrival_time > time_limit) {
+                                break;
+                            }
+
+                            auto& next_label = labels[next_node_id];
+                            std::uint64_t new_label = pack(arrival_time, source);
+                            std::uint64_t old_label = next_label.load(std::memory_order_relaxed);
+
+                            // Same cut-off as in the serial engine
+                            if ((old_label >> 32) <= static_cast<std::uint64_t>(arrival_time)) {
+                                break;
+                            }
+
+                            while (new_label < old_label
+                                && !next_label.compare_exchange_weak(old_label, new_label,
+                                    std::memory_order_relaxed)) {
+                            }
+
+                            if (new_label < old_label) {
+                                out.emplace_back(bucket_of(arrival_time), next_node_id);
+                            }
+                        }
+                    }
+                }
+            }
+
+            phase_barrier.arrive_and_wait();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return maps;
+}
+
+void astar::output_reachability(const reachability& map) const
+{
+    std::ofstream file("isochrone.txt");
+
+    for (int i = 1; i < map.arrival_times.size(); ++i) {
+        if (map.arrival_times[i] < 0) {
+            continue;
+        }
+
+        file << i << '\t' << _nodes[i].stop_name
+            << '\t' << time_to_str(map.arrival_times[i])
+            << '\t' << map.source_stop_ids[i] << std::endl;
+    }
+}
+
+auto astar::compute_ride_tree(int start_stop_id, int start_stop_time) const -> ride_tree
+{
+    ride_tree tree;
+    tree.start_stop_time = start_stop_time;
+    tree.arrival_times.assign(_nodes.size(), -1);
+    tree.boarding_stop_ids.assign(_nodes.size(), -1);
+    tree.ride_counts.assign(_nodes.size(), 0);
+
+    if (start_stop_id <= 0 || start_stop_id >= _nodes.size()) {
+        return tree;
+    }
+
+    // Same trip-based search as compute_reachability(), but labels are
+    // (arrival, rides) so that equally fast routes keep the fewest transfers
+    auto better = [&](int node_id, int arrival_time, int rides) {
+        return tree.arrival_times[node_id] < 0
+            || std::make_pair(arrival_time, rides)
+                < std::make_pair(tree.arrival_times[node_id], tree.ride_counts[node_id]);
+    };
+
+    std::priority_queue<std::tuple<int, int, int>> open_nodes;
+    tree.arrival_times[start_stop_id] = start_stop_time;
+    open_nodes.push(std::make_tuple(-start_stop_time, 0, start_stop_id));
+
+    while (!open_nodes.empty()) {
+        auto [pq_cost, pq_rides, node_id] = open_nodes.top();
+        open_nodes.pop();
+
+        if (-pq_cost != tree.arrival_times[node_id] || -pq_rides != tree.ride_counts[node_id]) {
+            continue;
+        }
+
+        int rides = tree.ride_counts[node_id] + 1;
+        for (auto& hop : _nodes[node_id].patterns) {
+            trip_ref trip = first_trip(hop, -pq_cost);
+            if (!trip) {
+                continue;
+            }
+
+            const route_pattern& pattern = _patterns[hop.pattern];
+            int trip_start = pattern.trip_starts[trip.trip];
+
+            for (int i = hop.index + 1; i < pattern.stops.size(); ++i) {
+                int next_node_id = pattern.stops[i];
+                int arrival_time = trip_start + pattern.offsets[i];
+
+                if (!better(next_node_id, arrival_time, rides)) {
+                    // Boarding again there covers the rest of the ride only
+                    // if it does not cost an extra transfer
+                    if (tree.arrival_times[next_node_id] < arrival_time
+                        || tree.ride_counts[next_node_id] < rides) {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                tree.arrival_times[next_node_id] = arrival_time;
+                tree.boarding_stop_ids[next_node_id] = node_id;
+                tree.ride_counts[next_node_id] = rides;
+                open_nodes.emplace(std::make_tuple(-arrival_time, -rides, next_node_id));
+            }
+        }
+    }
+
+    return tree;
+}
+
+auto astar::find_direct_connection(int start_stop_id, int end_stop_id,
+    int start_stop_time, const std::string* line) const -> std::optional<result_stage>
+{
+    std::optional<result_stage> best;
+
+    for (auto& hop : _nodes[start_stop_id].patterns) {
+        const route_pattern& pattern = _patterns[hop.pattern];
+        if (line && pattern.line != *line) {
+            continue;
+        }
+
+        int end_index = hop.index + 1;
+        while (end_index < pattern.stops.size() && pattern.stops[end_index] != end_stop_id) {
+            ++end_index;
+        }
+
+        if (end_index == pattern.stops.size()) {
+            continue;
+        }
+
+        trip_ref trip = first_trip(hop, start_stop_time);
+        if (!trip) {
+            continue;
+        }
+
+        int arrival_time = pattern.trip_starts[trip.trip] + pattern.offsets[end_index];
+        if (!best || arrival_time < best->offboard_time) {
+            best = result_stage{
+                .line = pattern.line,
+                .start_stop = _nodes[start_stop_id].stop_name,
+                .onboard_time = departure_of(trip),
+                .end_stop = _nodes[end_stop_id].stop_name,
+                .offboard_time = arrival_time,
+            };
+        }
+    }
+
+    return best;
 }
 
 auto astar::construct_result(int start_stop_id, int end_stop_id,
-    bool optimize_time, int start_stop_time) const -> result
+    int start_stop_time) const -> result
 {
     result result;
 
@@ -432,11 +1304,11 @@ auto astar::construct_result(int start_stop_id, int end_stop_id,
     result.start_stop = _nodes[start_stop_id].stop_name;
     result.end_stop = _nodes[end_stop_id].stop_name;
     result.start_stop_time = start_stop_time;
-    result.end_arrival_time = std::get<ARRIVAL>(*_nodes[end_stop_id].previous_edge);
-    result.total_vehicle_changes = _nodes[end_stop_id].veh_change_count - optimize_time;
+    result.end_arrival_time = arrival_of(_nodes[end_stop_id].previous_edge);
+    result.total_vehicle_changes = _nodes[end_stop_id].veh_change_count - 1;
     result.total_cost = _nodes[end_stop_id].current_cost;
 
-    std::stack<single_edge*> route;
+    std::stack<trip_ref> route;
     std::stack<int> route_nodes;
     result_stage current_stage;
     int current_node = end_stop_id;
@@ -451,7 +1323,9 @@ auto astar::construct_result(int start_stop_id, int end_stop_id,
     std::string current_line = "";
     int previous_arrival = 0;
     while (!route.empty() && !route_nodes.empty()) {
-        auto&& [start_hr, end_hr, line] = *route.top();
+        int start_hr = departure_of(route.top());
+        int end_hr = arrival_of(route.top());
+        const std::string& line = line_of(route.top());
 
         if (line != current_line) {
             if (!current_line.empty()) {
@@ -1,4 +1,8 @@
 #pragma once
+#include "stop_index.h"
+
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -43,22 +47,118 @@ public:
         std::vector<result_stage> stages;
     };
 
+    struct reachability {
+        int start_stop_time;
+        int time_budget;
+        int reached_count;
+
+        // Both indexed by stop id; -1 marks stops not reached within the budget
+        std::vector<int> arrival_times;
+        std::vector<int> source_stop_ids;
+    };
+
+    struct ride_tree {
+        int start_stop_time;
+
+        // Indexed by stop id; for every reached stop the stop where the last
+        // ride leading to it was boarded, -1 for the start stop
+        std::vector<int> arrival_times;
+        std::vector<int> boarding_stop_ids;
+        std::vector<int> ride_counts;
+    };
+
+    struct transfer_tree {
+        struct label {
+            int stop_id;
+            int arrival_time;
+            int transfers;
+            // Label the ride was boarded from, -1 at the start stop
+            int previous;
+            int boarding_stop_id;
+            int line_id;
+        };
+
+        int start_stop_time;
+        std::vector<label> labels;
+
+        // Indexed by stop id: the (transfers, arrival) Pareto front of the
+        // stop, by increasing transfers and so by decreasing arrival
+        std::vector<std::vector<int>> stop_labels;
+    };
+
     astar(const std::vector<graph_edge>& edges);
 
     void preprocess();
     void output_stop_names();
+    int get_stop_count() const;
+    int get_ambiguous_join_count() const;
+    const std::string& get_stop_name(int stop_id) const;
+    const std::string& get_line_name(int line_id) const;
+    const stop_index& get_stop_index() const;
     std::unordered_set<std::string> get_lines_at_stop(int stop_id) const;
     result compute_dijkstra(int start_stop_id, int end_stop_id,
         int start_stop_time);
-    result compute(int start_stop_id, int end_stop_id,
-        bool optimize_time, int start_stop_time, std::string start_line = "");
+    result compute(int start_stop_id, int end_stop_id, int start_stop_time);
+    result compute_fewest_transfers(int start_stop_id, int end_stop_id,
+        int start_stop_time) const;
+    reachability compute_reachability(int start_stop_id, int start_stop_time,
+        int time_budget) const;
+    reachability compute_reachability(const std::vector<int>& start_stop_ids,
+        int start_stop_time, int time_budget) const;
+    reachability compute_reachability_parallel(const std::vector<int>& start_stop_ids,
+        int start_stop_time, int time_budget, int thread_count, int delta = 120) const;
+    std::vector<reachability> compute_reachability_parallel(
+        const std::vector<std::vector<int>>& start_stop_id_sets, int start_stop_time,
+        int time_budget, int thread_count, int delta = 120) const;
+    void output_reachability(const reachability& map) const;
+    ride_tree compute_ride_tree(int start_stop_id, int start_stop_time) const;
+    transfer_tree compute_transfer_tree(int start_stop_id, int start_stop_time) const;
+    std::optional<result_stage> find_direct_connection(int start_stop_id,
+        int end_stop_id, int start_stop_time, const std::string* line = nullptr) const;
 
 private:
-    using single_edge = std::tuple<int, int, std::string>;
+    // Runs with identical stop sequences and hop times of the same line share
+    // a single pattern, every run is stored only as its start time
+    struct route_pattern {
+        std::string line;
+        int line_id;
+        std::vector<int> stops;
+        std::vector<int> offsets;
+        std::vector<int> trip_starts;
+
+        // Id of the (stop, line) state at every stop, see compute_fewest_transfers()
+        std::vector<int> states;
+    };
+
+    struct pattern_hop {
+        int pattern;
+        int index;
+    };
+
+    struct trip_ref {
+        int pattern = -1;
+        int trip = 0;
+        int index = 0;
+
+        explicit operator bool() const { return pattern >= 0; }
+    };
+
+    // Labels are (transfers, arrival) of (stop, line) states, see
+    // search_transfers()
+    struct transfer_label {
+        int state;
+        int arrival;
+        int transfers;
+        // Label the ride was boarded from, -1 at the start stop
+        int previous;
+        // Trip ridden, boarded at ride.index and left at alight_index
+        trip_ref ride;
+        int alight_index;
+    };
 
     struct timetable_edge {
         int destination;
-        std::vector<single_edge> times;
+        std::vector<pattern_hop> hops;
     };
 
     struct node_info {
@@ -66,26 +166,45 @@ private:
         float lon, lat;
 
         int previous_node;
-        single_edge* previous_edge;
+        trip_ref previous_edge;
         int veh_change_count;
 
         std::uint64_t total_cost;
         std::uint64_t current_cost;
         std::uint64_t estimated_cost;
         std::vector<timetable_edge> neighbors;
+        std::vector<pattern_hop> patterns;
     };
 
     int get_max_node_id() const;
     float get_max_velocity() const;
+    std::vector<route_pattern> construct_route_patterns(int& ambiguous_joins) const;
     std::vector<node_info> construct_node_info(int node_max_id);
+    int construct_line_states();
     std::uint64_t compute_heuristics(node_info& current, node_info& destination) const;
-    std::tuple<std::uint64_t, single_edge*, bool> travel_cost(bool optimize_time,
-        node_info& current, timetable_edge& next, const std::string& current_line) const;
+    std::tuple<std::uint64_t, trip_ref, bool> travel_cost(node_info& current,
+        timetable_edge& next, const std::string& current_line) const;
+
+    trip_ref first_trip(const pattern_hop& hop, int current_time) const;
+    trip_ref first_run(const timetable_edge& next, int current_time,
+        const std::string* line = nullptr) const;
+    bool run_before(const trip_ref& first, const trip_ref& second) const;
+    int departure_of(const trip_ref& run) const;
+    int arrival_of(const trip_ref& run) const;
+    const std::string& line_of(const trip_ref& run) const;
+    std::size_t timetable_size() const;
+    int search_transfers(int start_stop_id, int start_stop_time, int end_stop_id,
+        std::vector<transfer_label>& labels, std::vector<int>& settled) const;
 
     result construct_result(int start_stop_id, int end_stop_id,
-        bool optimize_time, int start_stop_time) const;
+        int start_stop_time) const;
 
     const std::vector<graph_edge>& _edges;
     float _max_velocity;
+    std::vector<route_pattern> _patterns;
+    int _ambiguous_joins;
     std::vector<node_info> _nodes;
+    int _line_state_count;
+    std::vector<std::string> _line_names;
+    stop_index _stop_index;
 };
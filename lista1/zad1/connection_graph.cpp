@@ -0,0 +1,85 @@
+#include "connection_graph.h"
+#include "utils.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+bool read_connection_graph(const char* path, std::vector<graph_edge>& edges)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    std::getline(file, line);
+
+    float fix_longitude = cos(51.08 / 180.0 * 3.141592653589);
+
+    char buffer[1024];
+    while (!file.eof()) {
+        std::getline(file, line);
+        std::istringstream iss(line);
+        graph_edge edge;
+
+        iss.getline(buffer, 1024, ',');
+        edge.id = atoi(buffer);
+        iss.getline(buffer, 1024, ',');
+        edge.company = buffer;
+        iss.getline(buffer, 1024, ',');
+        edge.line = buffer;
+        iss.getline(buffer, 1024, ',');
+        edge.departure_time = time_to_int(buffer);
+        iss.getline(buffer, 1024, ',');
+        edge.arrival_time = time_to_int(buffer);
+        iss.getline(buffer, 1024, ',');
+        edge.start_stop = buffer;
+        iss.getline(buffer, 1024, ',');
+        edge.end_stop = buffer;
+        iss.getline(buffer, 1024, ',');
+        edge.start_stop_lat = static_cast<float>(atof(buffer));
+        iss.getline(buffer, 1024, ',');
+        edge.start_stop_lon = static_cast<float>(atof(buffer));
+        edge.start_stop_lon *= fix_longitude;
+
+        iss.getline(buffer, 1024, ',');
+        edge.end_stop_lat = static_cast<float>(atof(buffer));
+        iss.getline(buffer, 1024, ',');
+        edge.end_stop_lon = static_cast<float>(atof(buffer));
+        edge.end_stop_lon *= fix_longitude;
+
+        if (!file.eof()) {
+            edges.emplace_back(std::move(edge));
+        }
+    }
+
+    return true;
+}
+
+void hash_stop_ids(std::vector<graph_edge>& edges)
+{
+    std::unordered_map<std::string, int> name_map;
+    int index = 0;
+
+    for (graph_edge& edge : edges) {
+        auto start_it = name_map.find(edge.start_stop);
+        if (start_it != name_map.end()) {
+            edge.start_stop_id = start_it->second;
+        }
+        else {
+            name_map[edge.start_stop] = edge.start_stop_id = ++index;
+        }
+
+        auto end_it = name_map.find(edge.end_stop);
+        if (end_it != name_map.end()) {
+            edge.end_stop_id = end_it->second;
+        }
+        else {
+            name_map[edge.end_stop] = edge.end_stop_id = ++index;
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "astar.h"
+
+#include <vector>
+
+// Appends the runs of a connection graph CSV file to edges, false if the
+// file cannot be opened
+bool read_connection_graph(const char* path, std::vector<graph_edge>& edges);
+
+// Numbers the stops by name from 1, in order of their first appearance
+void hash_stop_ids(std::vector<graph_edge>& edges);
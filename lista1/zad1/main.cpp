@@ -1,109 +1,210 @@
 #include "astar.h"
+#include "connection_graph.h"
+#include "stop_index.h"
+#include "transfer_patterns.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cctype>
 #include <chrono>
-#include <fstream>
 #include <iostream>
-#include <sstream>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
 static std::vector<graph_edge> edges;
 
-static int time_to_int(const char* buffer) {
-    if (strlen(buffer) < 8) {
-        return 0;
+int read_stop_id(const astar& algorithm, const char* prompt)
+{
+    static const std::size_t MAX_SUGGESTIONS = 10;
+
+    while (true) {
+        std::string query;
+        std::cout << prompt;
+        if (!std::getline(std::cin >> std::ws, query)) {
+            return 0;
+        }
+
+        if (!query.empty() && std::all_of(query.begin(), query.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            return atoi(query.c_str());
+        }
+
+        auto stop_ids = algorithm.get_stop_index().find(query, MAX_SUGGESTIONS);
+        if (stop_ids.size() == 1
+            || (!stop_ids.empty() && stop_index::normalize(algorithm.get_stop_name(stop_ids[0]))
+                == stop_index::normalize(query))) {
+            std::cout << "Wybrano: " << algorithm.get_stop_name(stop_ids[0]) << std::endl;
+            return stop_ids[0];
+        }
+
+        if (stop_ids.empty()) {
+            std::cout << "Nie znaleziono przystanku!" << std::endl;
+            continue;
+        }
+
+        std::cout << "Pasujace przystanki:" << std::endl;
+        for (int stop_id : stop_ids) {
+            std::cout << " " << stop_id << '\t' << algorithm.get_stop_name(stop_id) << std::endl;
+        }
+    }
+}
+
+void print_result(const astar::result& result)
+{
+    if (!result.success) {
+        std::cout << "Nie znaleziono rozwiazania!" << std::endl;
+        return;
     }
 
-    char mybuf[3] = { 0 };
-    mybuf[0] = buffer[0];
-    mybuf[1] = buffer[1];
-    int hours = atoi(mybuf);
-    mybuf[0] = buffer[3];
-    mybuf[1] = buffer[4];
-    int minutes = atoi(mybuf);
-    mybuf[0] = buffer[6];
-    mybuf[1] = buffer[7];
-    int seconds = atoi(mybuf);
-
-    return hours * 3600 + minutes * 60 + seconds;
+    std::cout << "Rozwiazanie:" << std::endl;
+    std::cout << "Podroz z " << result.start_stop
+        << " do " << result.end_stop
+        << ", o godzinie " << time_to_str(result.start_stop_time)
+        << std::endl;
+    std::cout << "Czas dotarcia: " << time_to_str(result.end_arrival_time)
+        << ", Przesiadki: " << result.total_vehicle_changes << std::endl;
+    std::cout << "Funkcja kosztu: " << result.total_cost << std::endl;
+
+    for (auto& stage : result.stages) {
+        std::cout << "Linia " << stage.line << ": " << std::endl;
+        std::cout << " - Wsiadz na przystanku " << stage.start_stop << std::endl;
+        std::cout << " - Godzina: " << time_to_str(stage.onboard_time) << std::endl;
+        std::cout << " - Wysiadz na przystanku " << stage.end_stop << std::endl;
+        std::cout << " - Godzina: " << time_to_str(stage.offboard_time) << std::endl;
+    }
 }
 
-bool read_data()
+int run_transfer_patterns(const astar& algorithm)
 {
-    std::ifstream file("connection_graph.csv");
-    if (!file.is_open()) {
-        return false;
+    static const int HUB_COUNT = 200;
+    static const int TIME_STEP = 10 * 60;
+
+    int start_stop_id, end_stop_id;
+    char temp;
+    std::string temp_str;
+
+    transfer_patterns patterns(algorithm);
+    auto time1 = std::chrono::steady_clock::now();
+    patterns.precompute(HUB_COUNT, 4 * 60 * 60, 24 * 60 * 60, TIME_STEP);
+    auto time2 = std::chrono::steady_clock::now();
+
+    std::cout << "Czas wyznaczania wzorcow: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(time2 - time1)
+        << ", wzorce: " << patterns.get_pattern_count()
+        << ", wezly: " << patterns.get_node_count() << std::endl;
+
+    start_stop_id = read_stop_id(algorithm, "Podaj ID lub nazwe przystanku poczatkowego: >");
+    end_stop_id = read_stop_id(algorithm, "Podaj ID lub nazwe przystanku koncowego: >");
+    std::cout << "Optymalizacja czas czy przesiadki [t/p]: >";
+    std::cin >> temp;
+    std::cout << "Czas pojawienia sie na przystanku poczatkowym [HH:MM]: >";
+    std::cin >> temp_str;
+    temp_str += ":00";
+    int start_stop_time = time_to_int(temp_str.c_str());
+
+    if (!patterns.is_hub(start_stop_id) || !patterns.is_hub(end_stop_id)) {
+        std::cout << "Przystanki nie sa wezlami przesiadkowymi!" << std::endl;
+        return 0;
     }
 
-    std::string line;
-    std::getline(file, line);
-
-    float fix_longitude = cos(51.08 / 180.0 * 3.141592653589);
-
-    char buffer[1024];
-    while (!file.eof()) {
-        std::getline(file, line);
-        std::istringstream iss(line);
-        graph_edge edge;
-
-        iss.getline(buffer, 1024, ',');
-        edge.id = atoi(buffer);
-        iss.getline(buffer, 1024, ',');
-        edge.company = buffer;
-        iss.getline(buffer, 1024, ',');
-        edge.line = buffer;
-        iss.getline(buffer, 1024, ',');
-        edge.departure_time = time_to_int(buffer);
-        iss.getline(buffer, 1024, ',');
-        edge.arrival_time = time_to_int(buffer);
-        iss.getline(buffer, 1024, ',');
-        edge.start_stop = buffer;
-        iss.getline(buffer, 1024, ',');
-        edge.end_stop = buffer;
-        iss.getline(buffer, 1024, ',');
-        edge.start_stop_lat = static_cast<float>(atof(buffer));
-        iss.getline(buffer, 1024, ',');
-        edge.start_stop_lon = static_cast<float>(atof(buffer));
-        edge.start_stop_lon *= fix_longitude;
-
-        iss.getline(buffer, 1024, ',');
-        edge.end_stop_lat = static_cast<float>(atof(buffer));
-        iss.getline(buffer, 1024, ',');
-        edge.end_stop_lon = static_cast<float>(atof(buffer));
-        edge.end_stop_lon *= fix_longitude;
-
-        if (!file.eof()) {
-            edges.emplace_back(std::move(edge));
-        }
+    auto time3 = std::chrono::steady_clock::now();
+    auto result = patterns.compute(start_stop_id, end_stop_id, temp != 'p', start_stop_time);
+    auto time4 = std::chrono::steady_clock::now();
+
+    std::cout << "Czas wykonywania algorytmu: "
+        << std::chrono::duration_cast<std::chrono::microseconds>(time4 - time3)
+        << std::endl;
+
+    print_result(result);
+    return 0;
+}
+
+int run_reachability(const astar& algorithm)
+{
+    std::vector<int> start_stop_ids;
+    int start_stop_id, time_budget;
+    std::string temp_str;
+
+    while ((start_stop_id = read_stop_id(algorithm,
+        "Podaj ID lub nazwe przystanku poczatkowego, 0 konczy: >")) != 0) {
+        start_stop_ids.push_back(start_stop_id);
     }
+    std::cout << "Czas pojawienia sie na przystankach poczatkowych [HH:MM]: >";
+    std::cin >> temp_str;
+    temp_str += ":00";
+    int start_stop_time = time_to_int(temp_str.c_str());
+    std::cout << "Limit czasu podrozy [min]: >";
+    std::cin >> time_budget;
+
+    auto time1 = std::chrono::steady_clock::now();
+    auto map = algorithm.compute_reachability(start_stop_ids, start_stop_time, time_budget * 60);
+    auto time2 = std::chrono::steady_clock::now();
 
-    return true;
+    std::cout << "Czas wykonywania algorytmu: "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(time2 - time1)
+        << std::endl;
+    std::cout << "Osiagalne przystanki: " << map.reached_count
+        << " [plik isochrone.txt]" << std::endl;
+
+    algorithm.output_reachability(map);
+    return 0;
 }
 
-void hash_stop_ids()
+int run_reachability_benchmark(const astar& algorithm)
 {
-    std::unordered_map<std::string, int> name_map;
-    int index = 0;
+    int stop_count = algorithm.get_stop_count();
+    int time_budget;
+    std::string temp_str;
 
-    for (graph_edge& edge : edges) {
-        auto start_it = name_map.find(edge.start_stop);
-        if (start_it != name_map.end()) {
-            edge.start_stop_id = start_it->second;
-        }
-        else {
-            name_map[edge.start_stop] = edge.start_stop_id = ++index;
-        }
+    std::cout << "Czas pojawienia sie na przystankach poczatkowych [HH:MM]: >";
+    std::cin >> temp_str;
+    temp_str += ":00";
+    int start_stop_time = time_to_int(temp_str.c_str());
+    std::cout << "Limit czasu podrozy [min]: >";
+    std::cin >> time_budget;
+    time_budget *= 60;
 
-        auto end_it = name_map.find(edge.end_stop);
-        if (end_it != name_map.end()) {
-            edge.end_stop_id = end_it->second;
-        }
-        else {
-            name_map[edge.end_stop] = edge.end_stop_id = ++index;
+    // Sweep from every stop, serial engine first as a reference
+    std::vector<std::vector<int>> reference(stop_count + 1);
+    auto time1 = std::chrono::steady_clock::now();
+    for (int i = 1; i <= stop_count; ++i) {
+        reference[i] = algorithm.compute_reachability(i, start_stop_time, time_budget).arrival_times;
+    }
+    auto serial_time = std::chrono::steady_clock::now() - time1;
+
+    std::cout << "Dijkstra (1 watek): "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(serial_time)
+        << std::endl;
+
+    // All sources go in one batch, so the threads are started once per
+    // thread count instead of once per source
+    std::vector<std::vector<int>> sources;
+    for (int i = 1; i <= stop_count; ++i) {
+        sources.push_back({ i });
+    }
+
+    int max_threads = std::max(1U, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= max_threads; ++threads) {
+        bool valid = true;
+
+        auto time2 = std::chrono::steady_clock::now();
+        auto maps = algorithm.compute_reachability_parallel(
+            sources, start_stop_time, time_budget, threads);
+        auto parallel_time = std::chrono::steady_clock::now() - time2;
+
+        for (int i = 1; i <= stop_count; ++i) {
+            valid = valid && maps[i - 1].arrival_times == reference[i];
         }
+
+        std::cout << "Delta-stepping (" << threads << " watki): "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(parallel_time)
+            << ", przyspieszenie: "
+            << std::chrono::duration<double>(serial_time) / parallel_time
+            << (valid ? "" : ", WYNIKI NIEZGODNE!")
+            << std::endl;
     }
+
+    return 0;
 }
 
 int main()
@@ -114,13 +215,13 @@ int main()
     edges.reserve(1'000'000);
     std::cout << "Wczytywanie pliku z danymi..." << std::endl;
 
-    if (!read_data()) {
+    if (!read_connection_graph("connection_graph.csv", edges)) {
         std::cerr << "Wystapil blad!" << std::endl;
         return 1;
     }
 
     std::cout << "Hashowanie nazw przystankow..." << std::endl;
-    hash_stop_ids();
+    hash_stop_ids(edges);
 
     astar algorithm(edges);
     algorithm.preprocess();
@@ -130,14 +231,21 @@ int main()
     char temp;
     std::string temp_str;
 
-    std::cout << "Podaj ID przystanku poczatkowego [plik stops.txt]: >";
-    std::cin >> start_stop_id;
-    std::cout << "Podaj ID przystanku koncowego [plik stops.txt]: >";
-    std::cin >> end_stop_id;
-    std::cout << "Optymalizacja Dijkstra czy A* czas czy A* przesiadki [d/t/p]: >";
+    std::cout << "Optymalizacja Dijkstra czy A* czas czy przesiadki, "
+        << "albo mapa zasiegu lub jej benchmark, albo wzorce przesiadek [d/t/p/i/b/h]: >";
     std::cin >> temp;
-    bool dijkstra = temp == 'd';
-    bool optimize_time = dijkstra || temp == 't';
+    if (temp == 'i') {
+        return run_reachability(algorithm);
+    }
+    if (temp == 'b') {
+        return run_reachability_benchmark(algorithm);
+    }
+    if (temp == 'h') {
+        return run_transfer_patterns(algorithm);
+    }
+
+    start_stop_id = read_stop_id(algorithm, "Podaj ID lub nazwe przystanku poczatkowego: >");
+    end_stop_id = read_stop_id(algorithm, "Podaj ID lub nazwe przystanku koncowego: >");
     std::cout << "Czas pojawienia sie na przystanku poczatkowym [HH:MM]: >";
     std::cin >> temp_str;
     temp_str += ":00";
@@ -145,29 +253,15 @@ int main()
 
     auto time1 = std::chrono::steady_clock::now();
     astar::result result;
-    result.total_cost = std::numeric_limits<decltype(result.total_cost)>().max();
 
-    if (optimize_time) {
-        if (dijkstra) {
-            result = algorithm.compute_dijkstra(
-                start_stop_id, end_stop_id, start_stop_time);
-        }
-        else {
-            result = algorithm.compute(
-                start_stop_id, end_stop_id, optimize_time, start_stop_time);
-        }
+    if (temp == 'd') {
+        result = algorithm.compute_dijkstra(start_stop_id, end_stop_id, start_stop_time);
+    }
+    else if (temp == 't') {
+        result = algorithm.compute(start_stop_id, end_stop_id, start_stop_time);
     }
     else {
-        for (auto& line : algorithm.get_lines_at_stop(start_stop_id)) {
-            std::cout << "Uruchamianie dla linii " << line << "..." << std::endl;
-
-            auto new_result = algorithm.compute(
-                start_stop_id, end_stop_id, optimize_time, start_stop_time, line);
-
-            if (new_result.total_cost < result.total_cost) {
-                result = std::move(new_result);
-            }
-        }
+        result = algorithm.compute_fewest_transfers(start_stop_id, end_stop_id, start_stop_time);
     }
     auto time2 = std::chrono::steady_clock::now();
 
@@ -175,27 +269,6 @@ int main()
         << std::chrono::duration_cast<std::chrono::milliseconds>(time2 - time1)
         << std::endl;
 
-    if (!result.success) {
-        std::cout << "Nie znaleziono rozwiazania!" << std::endl;
-        return 0;
-    }
-
-    std::cout << "Rozwiazanie:" << std::endl;
-    std::cout << "Podroz z " << result.start_stop
-        << " do " << result.end_stop
-        << ", o godzinie " << time_to_str(result.start_stop_time)
-        << std::endl;
-    std::cout << "Czas dotarcia: " << time_to_str(result.end_arrival_time)
-        << ", Przesiadki: " << result.total_vehicle_changes << std::endl;
-    std::cout << "Funkcja kosztu: " << result.total_cost << std::endl;
-
-    for (auto& stage : result.stages) {
-        std::cout << "Linia " << stage.line << ": " << std::endl;
-        std::cout << " - Wsiadz na przystanku " << stage.start_stop << std::endl;
-        std::cout << " - Godzina: " << time_to_str(stage.onboard_time) << std::endl;
-        std::cout << " - Wysiadz na przystanku " << stage.end_stop << std::endl;
-        std::cout << " - Godzina: " << time_to_str(stage.offboard_time) << std::endl;
-    }
-
+    print_result(result);
     return 0;
 }
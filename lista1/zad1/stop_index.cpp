@@ -0,0 +1,212 @@
+#include "stop_index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <sstream>
+#include <tuple>
+
+
+static std::vector<std::string> split_words(const std::string& text)
+{
+    std::vector<std::string> words;
+    std::istringstream iss(text);
+    std::string word;
+
+    while (iss >> word) {
+        words.push_back(word);
+    }
+
+    return words;
+}
+
+static inline std::uint32_t trigram_key(const std::string& text, std::size_t pos)
+{
+    return (static_cast<std::uint8_t>(text[pos]) << 16)
+        | (static_cast<std::uint8_t>(text[pos + 1]) << 8)
+        | static_cast<std::uint8_t>(text[pos + 2]);
+}
+
+std::string stop_index::normalize(const std::string& name)
+{
+    // Two-byte UTF-8 sequences of Polish letters, both cases
+    static const std::pair<const char*, char> polish_letters[] = {
+        { "\xC4\x84", 'a' }, { "\xC4\x85", 'a' },
+        { "\xC4\x86", 'c' }, { "\xC4\x87", 'c' },
+        { "\xC4\x98", 'e' }, { "\xC4\x99", 'e' },
+        { "\xC5\x81", 'l' }, { "\xC5\x82", 'l' },
+        { "\xC5\x83", 'n' }, { "\xC5\x84", 'n' },
+        { "\xC3\x93", 'o' }, { "\xC3\xB3", 'o' },
+        { "\xC5\x9A", 's' }, { "\xC5\x9B", 's' },
+        { "\xC5\xB9", 'z' }, { "\xC5\xBA", 'z' },
+        { "\xC5\xBB", 'z' }, { "\xC5\xBC", 'z' },
+    };
+
+    std::string out;
+    out.reserve(name.size());
+
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        unsigned char c = name[i];
+
+        if (c < 0x80) {
+            // Punctuation separates words just like spaces do
+            if (std::isalnum(c)) {
+                out.push_back(static_cast<char>(std::tolower(c)));
+            }
+            else if (!out.empty() && out.back() != ' ') {
+                out.push_back(' ');
+            }
+            continue;
+        }
+
+        bool replaced = false;
+        if (i + 1 < name.size()) {
+            for (auto& [letter, ascii] : polish_letters) {
+                if (name[i] == letter[0] && name[i + 1] == letter[1]) {
+                    out.push_back(ascii);
+                    replaced = true;
+                    ++i;
+                    break;
+                }
+            }
+        }
+
+        if (!replaced) {
+            out.push_back(name[i]);
+        }
+    }
+
+    if (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+
+    return out;
+}
+
+void stop_index::build(const std::vector<std::string>& stop_names)
+{
+    _names.clear();
+    _name_words.clear();
+    _words.clear();
+    _trigrams.clear();
+
+    for (int stop_id = 0; stop_id < stop_names.size(); ++stop_id) {
+        _names.push_back(normalize(stop_names[stop_id]));
+        const std::string& name = _names.back();
+        _name_words.push_back(split_words(name));
+
+        for (auto& word : _name_words.back()) {
+            _words.push_back(std::make_pair(word, stop_id));
+        }
+
+        for (std::size_t i = 0; i + 3 <= name.size(); ++i) {
+            auto& postings = _trigrams[trigram_key(name, i)];
+            if (postings.empty() || postings.back() != stop_id) {
+                postings.push_back(stop_id);
+            }
+        }
+    }
+
+    std::sort(_words.begin(), _words.end());
+}
+
+bool stop_index::matches_words(int stop_id, const std::vector<std::string>& words) const
+{
+    auto& name_words = _name_words[stop_id];
+
+    for (auto& word : words) {
+        bool found = std::any_of(name_words.begin(), name_words.end(),
+            [&](const std::string& name_word) { return name_word.starts_with(word); });
+
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void stop_index::find_by_prefix(const std::vector<std::string>& words,
+    std::vector<std::pair<match_kind, int>>& out) const
+{
+    // The longest word is the most selective one to look up
+    const std::string& key = *std::max_element(words.begin(), words.end(),
+        [](const std::string& first, const std::string& second) { return first.size() < second.size(); });
+
+    auto it = std::lower_bound(_words.begin(), _words.end(), std::make_pair(key, 0));
+    for (; it != _words.end() && it->first.starts_with(key); ++it) {
+        int stop_id = it->second;
+
+        if (matches_words(stop_id, words)) {
+            out.push_back(std::make_pair(
+                _names[stop_id].starts_with(words.front()) ? NAME_PREFIX : WORD_PREFIX, stop_id));
+        }
+    }
+}
+
+void stop_index::find_by_trigrams(const std::string& query,
+    std::vector<std::pair<match_kind, int>>& out) const
+{
+    if (query.size() < 3) {
+        return;
+    }
+
+    std::vector<int> candidates;
+    for (std::size_t i = 0; i + 3 <= query.size(); ++i) {
+        auto it = _trigrams.find(trigram_key(query, i));
+        if (it == _trigrams.end()) {
+            return;
+        }
+
+        if (i == 0) {
+            candidates = it->second;
+        }
+        else {
+            std::vector<int> common;
+            std::set_intersection(candidates.begin(), candidates.end(),
+                it->second.begin(), it->second.end(), std::back_inserter(common));
+            candidates.swap(common);
+        }
+    }
+
+    for (int stop_id : candidates) {
+        if (_names[stop_id].find(query) != std::string::npos) {
+            out.push_back(std::make_pair(SUBSTRING, stop_id));
+        }
+    }
+}
+
+std::vector<int> stop_index::find(const std::string& query, std::size_t limit) const
+{
+    std::string normalized = normalize(query);
+    auto words = split_words(normalized);
+    if (words.empty()) {
+        return {};
+    }
+
+    std::vector<std::pair<match_kind, int>> matches;
+    find_by_prefix(words, matches);
+    if (matches.size() < limit) {
+        find_by_trigrams(normalized, matches);
+    }
+
+    // Best match kind first, shorter names before longer ones
+    std::sort(matches.begin(), matches.end(), [&](auto& first, auto& second) {
+        return std::make_tuple(first.first, _names[first.second].size(), first.second)
+            < std::make_tuple(second.first, _names[second.second].size(), second.second);
+        });
+
+    std::vector<int> out;
+    for (auto& [kind, stop_id] : matches) {
+        if (std::find(out.begin(), out.end(), stop_id) != out.end()) {
+            continue;
+        }
+
+        out.push_back(stop_id);
+        if (out.size() == limit) {
+            break;
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class stop_index {
+public:
+    void build(const std::vector<std::string>& stop_names);
+    std::vector<int> find(const std::string& query, std::size_t limit = 10) const;
+
+    static std::string normalize(const std::string& name);
+
+private:
+    enum match_kind {
+        NAME_PREFIX,
+        WORD_PREFIX,
+        SUBSTRING,
+    };
+
+    bool matches_words(int stop_id, const std::vector<std::string>& words) const;
+    void find_by_prefix(const std::vector<std::string>& words,
+        std::vector<std::pair<match_kind, int>>& out) const;
+    void find_by_trigrams(const std::string& query,
+        std::vector<std::pair<match_kind, int>>& out) const;
+
+    // Normalized names indexed by stop id, every word of a name in a sorted
+    // array for prefix lookups and posting lists for every name trigram
+    std::vector<std::string> _names;
+    std::vector<std::vector<std::string>> _name_words;
+    std::vector<std::pair<std::string, int>> _words;
+    std::unordered_map<std::uint32_t, std::vector<int>> _trigrams;
+};
@@ -0,0 +1,241 @@
+#include "transfer_patterns.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+
+
+transfer_patterns::transfer_patterns(const astar& algorithm)
+    : _algorithm(algorithm)
+{
+}
+
+std::vector<int> transfer_patterns::select_hubs(int hub_count) const
+{
+    // Major interchanges are the stops served by the most lines
+    std::vector<std::pair<int, int>> stops;
+    for (int i = 1; i <= _algorithm.get_stop_count(); ++i) {
+        stops.push_back(std::make_pair(-static_cast<int>(_algorithm.get_lines_at_stop(i).size()), i));
+    }
+
+    std::sort(stops.begin(), stops.end());
+
+    std::vector<int> hubs;
+    for (int i = 0; i < hub_count && i < stops.size(); ++i) {
+        hubs.push_back(stops[i].second);
+    }
+
+    return hubs;
+}
+
+void transfer_patterns::add_pattern(hub_patterns& hub, const std::vector<std::pair<int, int>>& rides)
+{
+    int node = 0;
+
+    for (auto [stop_id, line_id] : rides) {
+        auto key = std::make_tuple(node, stop_id, line_id);
+        auto it = hub.children.find(key);
+
+        if (it != hub.children.end()) {
+            node = it->second;
+            continue;
+        }
+
+        hub.nodes.push_back({
+            .stop_id = stop_id,
+            .parent = node,
+            .line_id = line_id,
+            });
+
+        node = static_cast<int>(hub.nodes.size()) - 1;
+        hub.children[key] = node;
+    }
+
+    auto& leaves = hub.targets[rides.back().first];
+    if (std::find(leaves.begin(), leaves.end(), node) == leaves.end()) {
+        leaves.push_back(node);
+    }
+}
+
+void transfer_patterns::precompute(int hub_count, int first_time, int last_time, int time_step)
+{
+    std::cout << "Wyznaczanie wzorcow przesiadek..." << std::endl;
+
+    std::vector<int> hubs = select_hubs(hub_count);
+    _hub_index.assign(_algorithm.get_stop_count() + 1, -1);
+    _hubs.assign(hubs.size(), hub_patterns{});
+
+    for (int i = 0; i < hubs.size(); ++i) {
+        _hub_index[hubs[i]] = i;
+        _hubs[i].nodes.push_back({ .stop_id = hubs[i], .parent = -1, .line_id = -1 });
+    }
+
+    // Every route of the (transfers, arrival) front of a target is kept, the
+    // last one of the front being the earliest arrival, so both criteria of
+    // compute() find their optimum among the patterns
+    for (int i = 0; i < hubs.size(); ++i) {
+        for (int time = first_time; time <= last_time; time += time_step) {
+            auto tree = _algorithm.compute_transfer_tree(hubs[i], time);
+
+            for (int target : hubs) {
+                if (target == hubs[i]) {
+                    continue;
+                }
+
+                for (int label_id : tree.stop_labels[target]) {
+                    // Walk back over the rides
+                    std::vector<std::pair<int, int>> rides;
+                    for (int id = label_id; id >= 0; id = tree.labels[id].previous) {
+                        rides.push_back(std::make_pair(tree.labels[id].stop_id, tree.labels[id].line_id));
+                    }
+
+                    std::reverse(rides.begin(), rides.end());
+                    add_pattern(_hubs[i], rides);
+                }
+            }
+        }
+    }
+}
+
+bool transfer_patterns::is_hub(int stop_id) const
+{
+    return stop_id > 0 && stop_id < _hub_index.size() && _hub_index[stop_id] >= 0;
+}
+
+std::size_t transfer_patterns::get_pattern_count() const
+{
+    std::size_t count = 0;
+
+    for (const hub_patterns& hub : _hubs) {
+        for (auto& [target, leaves] : hub.targets) {
+            count += leaves.size();
+        }
+    }
+
+    return count;
+}
+
+std::size_t transfer_patterns::get_node_count() const
+{
+    std::size_t count = 0;
+
+    for (const hub_patterns& hub : _hubs) {
+        count += hub.nodes.size();
+    }
+
+    return count;
+}
+
+astar::result transfer_patterns::compute(int start_stop_id, int end_stop_id,
+    bool optimize_time, int start_stop_time) const
+{
+    astar::result result;
+    result.success = false;
+
+    if (!is_hub(start_stop_id) || !is_hub(end_stop_id) || start_stop_id == end_stop_id) {
+        return result;
+    }
+
+    const hub_patterns& hub = _hubs[_hub_index[start_stop_id]];
+    auto target_it = hub.targets.find(end_stop_id);
+    if (target_it == hub.targets.end()) {
+        return result;
+    }
+
+    std::cout << "Uruchamianie wyszukiwania po wzorcach przesiadek..." << std::endl;
+
+    // Only nodes lying on some pattern of this target get evaluated
+    std::vector<char> needed(hub.nodes.size(), 0);
+    for (int leaf : target_it->second) {
+        for (int node = leaf; node >= 0 && !needed[node]; node = hub.nodes[node].parent) {
+            needed[node] = 1;
+        }
+    }
+
+    // Rides of a node stay on its line, so the query finds the very route
+    // the pattern was made of or an earlier one with the same transfers
+    std::vector<int> arrival_times(hub.nodes.size(), -1);
+    std::vector<int> transfers(hub.nodes.size(), 0);
+    std::vector<std::optional<astar::result_stage>> stages(hub.nodes.size());
+    arrival_times[0] = start_stop_time;
+
+    for (int node = 1; node < hub.nodes.size(); ++node) {
+        int parent = hub.nodes[node].parent;
+        if (!needed[node] || arrival_times[parent] < 0) {
+            continue;
+        }
+
+        stages[node] = _algorithm.find_direct_connection(
+            hub.nodes[parent].stop_id, hub.nodes[node].stop_id, arrival_times[parent],
+            &_algorithm.get_line_name(hub.nodes[node].line_id));
+
+        if (stages[node]) {
+            arrival_times[node] = stages[node]->offboard_time;
+            transfers[node] = transfers[parent]
+                + (parent > 0 && hub.nodes[parent].line_id != hub.nodes[node].line_id);
+        }
+    }
+
+    int best_leaf = -1;
+    for (int leaf : target_it->second) {
+        if (arrival_times[leaf] < 0) {
+            continue;
+        }
+
+        auto key = std::make_pair(arrival_times[leaf], transfers[leaf]);
+        if (!optimize_time) {
+            std::swap(key.first, key.second);
+        }
+
+        if (best_leaf >= 0) {
+            auto best_key = std::make_pair(arrival_times[best_leaf], transfers[best_leaf]);
+            if (!optimize_time) {
+                std::swap(best_key.first, best_key.second);
+            }
+
+            if (best_key <= key) {
+                continue;
+            }
+        }
+
+        best_leaf = leaf;
+    }
+
+    if (best_leaf < 0) {
+        return result;
+    }
+
+    result.success = true;
+    result.start_stop = _algorithm.get_stop_name(start_stop_id);
+    result.end_stop = _algorithm.get_stop_name(end_stop_id);
+    result.start_stop_time = start_stop_time;
+    result.end_arrival_time = arrival_times[best_leaf];
+    result.total_vehicle_changes = transfers[best_leaf];
+    result.total_cost = result.end_arrival_time;
+
+    std::vector<int> route;
+    for (int node = best_leaf; node > 0; node = hub.nodes[node].parent) {
+        route.push_back(node);
+    }
+
+    std::reverse(route.begin(), route.end());
+
+    // Consecutive rides of the same line make a single stage
+    for (int node : route) {
+        if (result.stages.empty() || result.stages.back().line != stages[node]->line) {
+            result.stages.push_back(*stages[node]);
+        }
+        else {
+            result.stages.back().end_stop = stages[node]->end_stop;
+            result.stages.back().offboard_time = stages[node]->offboard_time;
+        }
+    }
+
+    std::cout << "Znaleziono rozwiazanie: "
+        << time_to_str(result.end_arrival_time)
+        << ", przesiadki: " << result.total_vehicle_changes
+        << std::endl;
+
+    return result;
+}
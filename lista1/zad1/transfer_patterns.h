@@ -0,0 +1,44 @@
+#pragma once
+#include "astar.h"
+
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class transfer_patterns {
+public:
+    transfer_patterns(const astar& algorithm);
+
+    void precompute(int hub_count, int first_time, int last_time, int time_step);
+    bool is_hub(int stop_id) const;
+    std::size_t get_pattern_count() const;
+    std::size_t get_node_count() const;
+    astar::result compute(int start_stop_id, int end_stop_id,
+        bool optimize_time, int start_stop_time) const;
+
+private:
+    // Patterns of a hub share their common prefixes: every node is a stop
+    // where a ride on the node's line ends and the next one starts, its
+    // parent is the previous such stop and node 0 is the hub itself.
+    // Parents always come first.
+    struct pattern_node {
+        int stop_id;
+        int parent;
+        int line_id;
+    };
+
+    struct hub_patterns {
+        std::vector<pattern_node> nodes;
+        std::map<std::tuple<int, int, int>, int> children;
+        std::unordered_map<int, std::vector<int>> targets;
+    };
+
+    std::vector<int> select_hubs(int hub_count) const;
+    void add_pattern(hub_patterns& hub, const std::vector<std::pair<int, int>>& rides);
+
+    const astar& _algorithm;
+    std::vector<int> _hub_index;
+    std::vector<hub_patterns> _hubs;
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
 inline static std::string time_to_str(int time)
@@ -17,3 +19,23 @@ inline static std::string time_to_str(int time)
 
     return time_str;
 }
+
+inline static int time_to_int(const char* buffer)
+{
+    if (strlen(buffer) < 8) {
+        return 0;
+    }
+
+    char mybuf[3] = { 0 };
+    mybuf[0] = buffer[0];
+    mybuf[1] = buffer[1];
+    int hours = atoi(mybuf);
+    mybuf[0] = buffer[3];
+    mybuf[1] = buffer[4];
+    int minutes = atoi(mybuf);
+    mybuf[0] = buffer[6];
+    mybuf[1] = buffer[7];
+    int seconds = atoi(mybuf);
+
+    return hours * 3600 + minutes * 60 + seconds;
+}
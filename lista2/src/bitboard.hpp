@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// Boards of every size are laid out in the same 16x16 frame, smaller ones
+// take its (0, 0) corner
+inline constexpr int FRAME_SIZE = 16;
+
+// 256-bit set of frame cells, cell (x, y) is bit x * FRAME_SIZE + y.
+// Shifting by a direction moves every cell by (dx, dy) at once, cells
+// leaving the frame are dropped instead of wrapping into the next column.
+class bitboard {
+public:
+    static constexpr int WORDS = 4;
+    static constexpr int BITS = WORDS * 64;
+    static_assert(WORDS == 4 && FRAME_SIZE * FRAME_SIZE <= BITS);
+
+    constexpr bitboard() : _words{} {}
+
+    static constexpr bitboard cell(int pos)
+    {
+        bitboard out;
+        out.set(pos);
+        return out;
+    }
+
+    // All cells of a board of the given size
+    static constexpr bitboard square(int size)
+    {
+        bitboard out;
+        for (int x = 0; x < size; ++x) {
+            for (int y = 0; y < size; ++y) {
+                out.set(x * FRAME_SIZE + y);
+            }
+        }
+        return out;
+    }
+
+    // All cells with first <= y < last
+    static constexpr bitboard columns(int first, int last)
+    {
+        bitboard out;
+        for (int x = 0; x < FRAME_SIZE; ++x) {
+            for (int y = first; y < last; ++y) {
+                out.set(x * FRAME_SIZE + y);
+            }
+        }
+        return out;
+    }
+
+    constexpr void set(int pos) { _words[pos >> 6] |= 1ULL << (pos & 63); }
+    constexpr void reset(int pos) { _words[pos >> 6] &= ~(1ULL << (pos & 63)); }
+    constexpr bool test(int pos) const { return (_words[pos >> 6] >> (pos & 63)) & 1; }
+
+    constexpr bool any() const
+    {
+        return (_words[0] | _words[1] | _words[2] | _words[3]) != 0;
+    }
+
+    constexpr int count() const
+    {
+        return std::popcount(_words[0]) + std::popcount(_words[1])
+            + std::popcount(_words[2]) + std::popcount(_words[3]);
+    }
+
+    // Removes and returns the lowest set cell, the bitboard must not be empty
+    constexpr int pop()
+    {
+        for (int i = 0; i < WORDS; ++i) {
+            if (_words[i]) {
+                int pos = i * 64 + std::countr_zero(_words[i]);
+                _words[i] &= _words[i] - 1;
+                return pos;
+            }
+        }
+        return -1;
+    }
+
+    constexpr bitboard operator|(const bitboard& other) const
+    {
+        return bitboard(_words[0] | other._words[0], _words[1] | other._words[1],
+            _words[2] | other._words[2], _words[3] | other._words[3]);
+    }
+
+    constexpr bitboard operator&(const bitboard& other) const
+    {
+        return bitboard(_words[0] & other._words[0], _words[1] & other._words[1],
+            _words[2] & other._words[2], _words[3] & other._words[3]);
+    }
+
+    // Cells of this set that are not in the other one
+    constexpr bitboard without(const bitboard& other) const
+    {
+        return bitboard(_words[0] & ~other._words[0], _words[1] & ~other._words[1],
+            _words[2] & ~other._words[2], _words[3] & ~other._words[3]);
+    }
+
+    constexpr bitboard& operator|=(const bitboard& other) { return *this = *this | other; }
+    constexpr bitboard& operator&=(const bitboard& other) { return *this = *this & other; }
+    constexpr bool operator==(const bitboard& other) const = default;
+
+    template <int DX, int DY>
+    constexpr bitboard shift() const;
+
+private:
+    std::array<std::uint64_t, WORDS> _words;
+
+    constexpr bitboard(std::uint64_t w0, std::uint64_t w1, std::uint64_t w2, std::uint64_t w3)
+        : _words{ w0, w1, w2, w3 }
+    {
+    }
+
+    // Whole-board shifts towards higher and lower bit indices by 0 < N < 64
+    template <int N>
+    constexpr bitboard shift_up() const
+    {
+        return bitboard(_words[0] << N,
+            (_words[1] << N) | (_words[0] >> (64 - N)),
+            (_words[2] << N) | (_words[1] >> (64 - N)),
+            (_words[3] << N) | (_words[2] >> (64 - N)));
+    }
+
+    template <int N>
+    constexpr bitboard shift_down() const
+    {
+        return bitboard((_words[0] >> N) | (_words[1] << (64 - N)),
+            (_words[1] >> N) | (_words[2] << (64 - N)),
+            (_words[2] >> N) | (_words[3] << (64 - N)),
+            _words[3] >> N);
+    }
+};
+
+// Directions are template arguments so that every shift compiles down to
+// a few constant word shifts and a constant mask of the cells it can reach
+template <int DX, int DY>
+constexpr bitboard bitboard::shift() const
+{
+    constexpr int amount = DX * FRAME_SIZE + DY;
+    constexpr bitboard mask = columns(DY > 0 ? DY : 0, DY < 0 ? FRAME_SIZE + DY : FRAME_SIZE);
+    static_assert(amount > -64 && amount < 64);
+
+    if constexpr (amount > 0) {
+        return shift_up<amount>() & mask;
+    }
+    else if constexpr (amount < 0) {
+        return shift_down<-amount>() & mask;
+    }
+    else {
+        return *this & mask;
+    }
+}
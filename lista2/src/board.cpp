@@ -1,197 +1,321 @@
 #include "board.hpp"
 
+#include <algorithm>
 #include <array>
-#include <bitset>
 #include <cassert>
-
-template <typename A, typename B>
-inline std::pair<A, B> operator+(const std::pair<A, B>& first, const std::pair<A, B>& second)
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+// Which player's camp every cell belongs to, 0 for none
+template <typename Layout>
+static constexpr auto make_camp_map()
 {
-    return { first.first + second.first, first.second + second.second };
+    constexpr int size = Layout::SIZE;
+    std::array<std::array<int, size>, size> map{};
+
+    for (int x = 0; x < static_cast<int>(Layout::CAMP_ROWS.size()); ++x) {
+        for (int y = 0; y < Layout::CAMP_ROWS[x]; ++y) {
+            map[x][y] = 1;
+            map[size - 1 - x][size - 1 - y] = 2;
+        }
+    }
+
+    return map;
 }
 
-template <typename A, typename B>
-inline std::pair<A, B> operator*(const std::pair<A, B>& first, int scalar)
+template <typename Layout>
+static constexpr auto camp_map = make_camp_map<Layout>();
+
+template <typename Layout>
+static constexpr bool camps_are_disjoint()
 {
-    return { scalar * first.first, scalar * first.second };
+    constexpr int size = Layout::SIZE;
+    int first = 0;
+    int second = 0;
+
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < size; ++y) {
+            first += camp_map<Layout>[x][y] == 1;
+            second += camp_map<Layout>[x][y] == 2;
+        }
+    }
+
+    int rows = 0;
+    for (int row : Layout::CAMP_ROWS) {
+        rows += row;
+    }
+
+    return first == rows && second == rows;
 }
 
-static const int camp_map[16][16] = {
-    { 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, },
-};
+// Random key of every (cell, player) pair, a position hash is the XOR of
+// the keys of all its pieces. Generated with splitmix64 from a fixed seed.
+static constexpr auto zobrist_keys = [] {
+    std::array<std::array<std::uint64_t, 2>, FRAME_SIZE * FRAME_SIZE> keys{};
+    std::uint64_t state = 0x48616C6D61ULL;
+
+    for (auto& cell_keys : keys) {
+        for (auto& key : cell_keys) {
+            state += 0x9E3779B97F4A7C15ULL;
+            std::uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            key = z ^ (z >> 31);
+        }
+    }
+
+    return keys;
+}();
+
+// Distinguishes positions with the same pieces but a different player to move
+static constexpr std::uint64_t SECOND_PLAYER_KEY = 0xD1B54A32D192ED03ULL;
+
+static inline std::uint64_t zobrist_key(int x, int y, int player)
+{
+    return zobrist_keys[x * FRAME_SIZE + y][player - 1];
+}
 
-board::board()
-    : _metric_one([](move m) -> std::int64_t { return std::abs(m.x1 - m.x2) + std::abs(m.y1 - m.y2); })
-    , _metric_two([](move m) -> std::int64_t { return std::abs(m.x1 - m.x2) + std::abs(m.y1 - m.y2); })
+template <typename Layout>
+basic_board<Layout>::basic_board()
+    : _metric_one(&metric_tables<SIZE, manhattan_metric>)
+    , _metric_two(&metric_tables<SIZE, manhattan_metric>)
+    , _terms_one{}
+    , _terms_two{}
+    , _player_one_pieces{}
+    , _player_two_pieces{}
+    , _piece_index{}
     , _player_one_ok_pieces(0)
     , _player_two_ok_pieces(0)
     , _heuristic_one(0)
     , _heuristic_two(0)
+    , _hash(0)
 {
-    for (int x = 0; x < BOARD_SIZE; ++x) {
-        for (int y = 0; y < BOARD_SIZE; ++y) {
+    static_assert(camps_are_disjoint<Layout>(), "camps of the layout overlap");
+
+    for (int x = 0; x < SIZE; ++x) {
+        for (int y = 0; y < SIZE; ++y) {
             _pieces[x][y] = 0;
         }
     }
 }
 
-void board::set_metric_one(std::function<int64_t(move)> metric)
+template <typename Layout>
+void basic_board<Layout>::set_metric_one(metric_kind metric)
+{
+    _metric_one = &get_distance_tables<SIZE>(metric);
+    recompute_heuristics();
+}
+
+template <typename Layout>
+void basic_board<Layout>::set_metric_two(metric_kind metric)
+{
+    _metric_two = &get_distance_tables<SIZE>(metric);
+    recompute_heuristics();
+}
+
+template <typename Layout>
+void basic_board<Layout>::set_tables_one(const distance_tables<SIZE>* tables)
+{
+    _metric_one = tables;
+    recompute_heuristics();
+}
+
+template <typename Layout>
+void basic_board<Layout>::set_tables_two(const distance_tables<SIZE>* tables)
 {
-    _metric_one = metric;
+    _metric_two = tables;
+    recompute_heuristics();
 }
 
-void board::set_metric_two(std::function<int64_t(move)> metric)
+template <typename Layout>
+void basic_board<Layout>::set_terms_one(const evaluation_terms& terms)
 {
-    _metric_two = metric;
+    _terms_one = terms;
 }
 
-void board::set_piece(int x, int y, int player)
+template <typename Layout>
+void basic_board<Layout>::set_terms_two(const evaluation_terms& terms)
+{
+    _terms_two = terms;
+}
+
+// Cells and slots are stored as bytes, and every piece fits the arrays of
+// the batch evaluation
+static_assert(FRAME_SIZE * FRAME_SIZE <= 256);
+static_assert(FRAME_SIZE * FRAME_SIZE <= piece_distances::CAPACITY);
+
+template <typename Layout>
+void basic_board<Layout>::add_to_list(piece_list& list, int pos)
+{
+    _piece_index[pos] = static_cast<std::uint8_t>(list.count);
+    list.cells[list.count++] = static_cast<std::uint8_t>(pos);
+}
+
+template <typename Layout>
+void basic_board<Layout>::remove_from_list(piece_list& list, int pos)
+{
+    // The last piece takes over the freed slot
+    int slot = _piece_index[pos];
+    int last = list.cells[--list.count];
+    list.cells[slot] = static_cast<std::uint8_t>(last);
+    _piece_index[last] = static_cast<std::uint8_t>(slot);
+}
+
+template <typename Layout>
+void basic_board<Layout>::move_in_list(piece_list& list, int from, int to)
+{
+    int slot = _piece_index[from];
+    list.cells[slot] = static_cast<std::uint8_t>(to);
+    _piece_index[to] = static_cast<std::uint8_t>(slot);
+}
+
+template <typename Layout>
+void basic_board<Layout>::recompute_heuristics()
+{
+    // The farther my pieces are, the worse my position is, the farther
+    // my opponent's are, the better it is
+    _heuristic_one = 0;
+    _heuristic_two = 0;
+
+    for (int i = 0; i < _player_one_pieces.count; ++i) {
+        int x = _player_one_pieces.cells[i] / FRAME_SIZE;
+        int y = _player_one_pieces.cells[i] % FRAME_SIZE;
+        _heuristic_one -= _metric_one->first_corner[x][y];
+        _heuristic_two -= _metric_two->first_corner[x][y];
+    }
+
+    for (int i = 0; i < _player_two_pieces.count; ++i) {
+        int x = _player_two_pieces.cells[i] / FRAME_SIZE;
+        int y = _player_two_pieces.cells[i] % FRAME_SIZE;
+        _heuristic_one += _metric_one->last_corner[x][y];
+        _heuristic_two += _metric_two->last_corner[x][y];
+    }
+}
+
+template <typename Layout>
+void basic_board<Layout>::set_piece(int x, int y, int player)
 {
     assert(player >= 0 && player <= 2);
-    assert(x >= 0 && x < BOARD_SIZE && y >= 0 && y < BOARD_SIZE);
+    assert(x >= 0 && x < SIZE && y >= 0 && y < SIZE);
 
     remove_piece(x, y);
     _pieces[x][y] = player;
 
+    if (player) {
+        _hash ^= zobrist_key(x, y, player);
+    }
+
     if (player == 1) {
-        _player_one_pieces.push_back({ x, y });
+        add_to_list(_player_one_pieces, x * FRAME_SIZE + y);
+        _player_one_occupancy.set(x * FRAME_SIZE + y);
 
-        if (camp_map[x][y] == 1) {
+        if (camp_map<Layout>[x][y] == 1) {
             ++_player_one_ok_pieces;
         }
 
         // The farther I am, the worse my position is
-        _heuristic_one -= _metric_one(move{ 0, 0, x, y });
-        _heuristic_two -= _metric_two(move{ 0, 0, x, y });
+        _heuristic_one -= _metric_one->first_corner[x][y];
+        _heuristic_two -= _metric_two->first_corner[x][y];
     }
     else if (player == 2) {
-        _player_two_pieces.push_back({ x, y });
+        add_to_list(_player_two_pieces, x * FRAME_SIZE + y);
+        _player_two_occupancy.set(x * FRAME_SIZE + y);
 
-        if (camp_map[x][y] == 2) {
-            ++_player_one_ok_pieces;
+        if (camp_map<Layout>[x][y] == 2) {
+            ++_player_two_ok_pieces;
         }
 
         // The farther my opponent is, the better my position is
-        _heuristic_one += _metric_one(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x, y });
-        _heuristic_two += _metric_two(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x, y });
+        _heuristic_one += _metric_one->last_corner[x][y];
+        _heuristic_two += _metric_two->last_corner[x][y];
     }
 }
 
-int board::get_piece(int x, int y) const
+template <typename Layout>
+int basic_board<Layout>::get_piece(int x, int y) const
 {
-    assert(x >= 0 && x < BOARD_SIZE && y >= 0 && y < BOARD_SIZE);
+    assert(x >= 0 && x < SIZE && y >= 0 && y < SIZE);
     return _pieces[x][y];
 }
 
-void board::remove_piece(int x, int y)
+template <typename Layout>
+void basic_board<Layout>::remove_piece(int x, int y)
 {
     if (_pieces[x][y] == 1) {
-        for (auto it = _player_one_pieces.begin(); it != _player_one_pieces.end(); ++it) {
-            if (it->first == x && it->second == y) {
-                _player_one_pieces.erase(it);
-                break;
-            }
-        }
+        remove_from_list(_player_one_pieces, x * FRAME_SIZE + y);
 
-        if (camp_map[x][y] == 1) {
+        if (camp_map<Layout>[x][y] == 1) {
             --_player_one_ok_pieces;
         }
 
-        _heuristic_one += _metric_one(move{ 0, 0, x, y });
-        _heuristic_two += _metric_two(move{ 0, 0, x, y });
+        _heuristic_one += _metric_one->first_corner[x][y];
+        _heuristic_two += _metric_two->first_corner[x][y];
     }
     else if (_pieces[x][y] == 2) {
-        for (auto it = _player_two_pieces.begin(); it != _player_two_pieces.end(); ++it) {
-            if (it->first == x && it->second == y) {
-                _player_two_pieces.erase(it);
-                break;
-            }
-        }
+        remove_from_list(_player_two_pieces, x * FRAME_SIZE + y);
 
-        if (camp_map[x][y] == 2) {
+        if (camp_map<Layout>[x][y] == 2) {
             --_player_two_ok_pieces;
         }
 
-        _heuristic_one -= _metric_one(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x, y });
-        _heuristic_two -= _metric_two(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x, y });
+        _heuristic_one -= _metric_one->last_corner[x][y];
+        _heuristic_two -= _metric_two->last_corner[x][y];
     }
 
+    if (_pieces[x][y]) {
+        _hash ^= zobrist_key(x, y, _pieces[x][y]);
+    }
+
+    _player_one_occupancy.reset(x * FRAME_SIZE + y);
+    _player_two_occupancy.reset(x * FRAME_SIZE + y);
     _pieces[x][y] = 0;
 }
 
-void board::move_piece(int x1, int y1, int x2, int y2)
+template <typename Layout>
+void basic_board<Layout>::move_piece(int x1, int y1, int x2, int y2)
 {
     assert(_pieces[x1][y1]);
     assert(!_pieces[x2][y2]);
 
-    decltype(_player_one_pieces)::iterator it, end_it;
     if (_pieces[x1][y1] == 1) {
-        it = _player_one_pieces.begin();
-        end_it = _player_one_pieces.end();
+        move_in_list(_player_one_pieces, x1 * FRAME_SIZE + y1, x2 * FRAME_SIZE + y2);
+        _player_one_occupancy.reset(x1 * FRAME_SIZE + y1);
+        _player_one_occupancy.set(x2 * FRAME_SIZE + y2);
 
-        if (camp_map[x1][y1] == 1) {
-            --_player_one_ok_pieces;
-        }
+        _player_one_ok_pieces += (camp_map<Layout>[x2][y2] == 1) - (camp_map<Layout>[x1][y1] == 1);
 
-        _heuristic_one += _metric_one(move{ 0, 0, x1, y1 });
-        _heuristic_two += _metric_two(move{ 0, 0, x1, y1 });
-        _heuristic_one -= _metric_one(move{ 0, 0, x2, y2 });
-        _heuristic_two -= _metric_two(move{ 0, 0, x2, y2 });
+        _heuristic_one += _metric_one->first_corner[x1][y1];
+        _heuristic_two += _metric_two->first_corner[x1][y1];
+        _heuristic_one -= _metric_one->first_corner[x2][y2];
+        _heuristic_two -= _metric_two->first_corner[x2][y2];
     }
     else if (_pieces[x1][y1] == 2) {
-        it = _player_two_pieces.begin();
-        end_it = _player_two_pieces.end();
+        move_in_list(_player_two_pieces, x1 * FRAME_SIZE + y1, x2 * FRAME_SIZE + y2);
+        _player_two_occupancy.reset(x1 * FRAME_SIZE + y1);
+        _player_two_occupancy.set(x2 * FRAME_SIZE + y2);
 
-        if (camp_map[x1][y1] == 2) {
-            --_player_two_ok_pieces;
-        }
-
-        _heuristic_one -= _metric_one(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x1, y1 });
-        _heuristic_two -= _metric_two(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x1, y1 });
-        _heuristic_one += _metric_one(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x2, y2 });
-        _heuristic_two += _metric_two(move{ BOARD_SIZE - 1, BOARD_SIZE - 1, x2, y2 });
-    }
+        _player_two_ok_pieces += (camp_map<Layout>[x2][y2] == 2) - (camp_map<Layout>[x1][y1] == 2);
 
-    for (; it != end_it; ++it) {
-        if (it->first == x1 && it->second == y1) {
-            it->first = x2;
-            it->second = y2;
-        }
+        _heuristic_one -= _metric_one->last_corner[x1][y1];
+        _heuristic_two -= _metric_two->last_corner[x1][y1];
+        _heuristic_one += _metric_one->last_corner[x2][y2];
+        _heuristic_two += _metric_two->last_corner[x2][y2];
     }
 
+    _hash ^= zobrist_key(x1, y1, _pieces[x1][y1]) ^ zobrist_key(x2, y2, _pieces[x1][y1]);
     _pieces[x2][y2] = _pieces[x1][y1];
     _pieces[x1][y1] = 0;
-
-    if (camp_map[x2][y2] == 1 && _pieces[x2][y2] == 1) {
-        ++_player_one_ok_pieces;
-    }
-
-    if (camp_map[x2][y2] == 2 && _pieces[x2][y2] == 2) {
-        ++_player_two_ok_pieces;
-    }
 }
 
-void board::undo_move(int x1, int y1, int x2, int y2)
+template <typename Layout>
+void basic_board<Layout>::undo_move(int x1, int y1, int x2, int y2)
 {
     move_piece(x2, y2, x1, y1);
 }
 
-static const auto single_moves = std::array{
+static constexpr auto single_moves = std::array{
     std::pair { -1, -1 },
     std::pair { -1, 0 },
     std::pair { -1, 1 },
@@ -202,126 +326,388 @@ static const auto single_moves = std::array{
     std::pair { 1,1 },
 };
 
-inline int to_pos(std::pair<int, int> par) {
-    return par.first * BOARD_SIZE + par.second;
+// Calls f(std::integral_constant<std::size_t, i>) for every direction i, so
+// that the direction is a compile time constant inside of f
+template <typename F, std::size_t... I>
+inline void for_each_direction(F&& f, std::index_sequence<I...>)
+{
+    (f(std::integral_constant<std::size_t, I>{}), ...);
 }
 
-inline bool in_board(std::pair<int, int> par) {
-    return par.first >= 0 && par.first < BOARD_SIZE
-        && par.second >= 0 && par.second < BOARD_SIZE;
+template <typename F>
+inline void for_each_direction(F&& f)
+{
+    for_each_direction(f, std::make_index_sequence<single_moves.size()>{});
 }
 
-auto board::get_legal_moves(int player) const -> std::vector<move>
+// Every jump from every cell that stays on the board: the cell jumped
+// over and the landing cell
+struct jump_step {
+    std::uint8_t over;
+    std::uint8_t landing;
+};
+
+struct cell_jumps {
+    std::array<jump_step, single_moves.size()> steps;
+    int count;
+};
+
+template <int Size>
+static constexpr auto make_jump_table()
+{
+    std::array<cell_jumps, FRAME_SIZE * FRAME_SIZE> table{};
+
+    for (int x = 0; x < Size; ++x) {
+        for (int y = 0; y < Size; ++y) {
+            auto& jumps = table[x * FRAME_SIZE + y];
+
+            for (auto [dx, dy] : single_moves) {
+                int landing_x = x + 2 * dx;
+                int landing_y = y + 2 * dy;
+
+                if (landing_x >= 0 && landing_x < Size && landing_y >= 0 && landing_y < Size) {
+                    jumps.steps[jumps.count++] = jump_step{
+                        .over = static_cast<std::uint8_t>((x + dx) * FRAME_SIZE + y + dy),
+                        .landing = static_cast<std::uint8_t>(landing_x * FRAME_SIZE + landing_y),
+                    };
+                }
+            }
+        }
+    }
+
+    return table;
+}
+
+template <int Size>
+static constexpr auto jump_table = make_jump_table<Size>();
+
+template <typename Layout>
+auto basic_board<Layout>::get_legal_moves(int player) const -> std::vector<move>
+{
+    // Generated into a buffer kept by the thread, so the vector only takes
+    // the moves found and not the whole upper bound
+    static thread_local std::array<move, MAX_MOVES> buffer;
+    int count = get_legal_moves(player, buffer.data());
+    return std::vector<move>(buffer.begin(), buffer.begin() + count);
+}
+
+template <typename Layout>
+int basic_board<Layout>::get_legal_moves(int player, move* out) const
 {
     assert(player == 1 || player == 2);
 
-    std::vector<move> moves;
-    auto& pieces = player == 1 ? _player_one_pieces : _player_two_pieces;
+    int count = 0;
+
+    const bitboard& own = player == 1 ? _player_one_occupancy : _player_two_occupancy;
+    bitboard occupied = _player_one_occupancy | _player_two_occupancy;
+    bitboard empty = bitboard::square(SIZE).without(occupied);
+
+    // Single steps of all pieces at once, one shift per direction
+    for_each_direction([&](auto dir) {
+        constexpr auto delta = single_moves[dir];
+        bitboard targets = own.shift<delta.first, delta.second>() & empty;
+
+        while (targets.any()) {
+            int to = targets.pop();
+            int from = to - (delta.first * FRAME_SIZE + delta.second);
+
+            out[count++] = move{
+                .x1 = from / FRAME_SIZE, .y1 = from % FRAME_SIZE,
+                .x2 = to / FRAME_SIZE, .y2 = to % FRAME_SIZE,
+                };
+        }
+        });
+
+    // The jump graph over empty cells does not depend on which piece
+    // jumps, so every component is flooded once, from the first landing
+    // found in it, and serves all pieces whose first jump lands in it.
+    // Components are disjoint, which also means no destination is
+    // generated twice.
+    bitboard flooded;
+    bitboard pieces = own;
+
+    while (pieces.any()) {
+        const auto& jumps = jump_table<SIZE>[pieces.pop()];
+
+        for (int i = 0; i < jumps.count; ++i) {
+            const auto& step = jumps.steps[i];
+            if (!occupied.test(step.over) || occupied.test(step.landing) || flooded.test(step.landing)) {
+                continue;
+            }
 
-    for (auto& piece : pieces) {
-        std::bitset<BOARD_SIZE* BOARD_SIZE> visited;
-        visited.set(to_pos(piece));
+            bitboard jumpers;
+            bitboard component = get_jump_component(step.landing, occupied, own, jumpers);
+            flooded |= component;
+
+            while (jumpers.any()) {
+                int from = jumpers.pop();
+                bitboard targets = component;
+
+                while (targets.any()) {
+                    int to = targets.pop();
+
+                    out[count++] = move{
+                        .x1 = from / FRAME_SIZE, .y1 = from % FRAME_SIZE,
+                        .x2 = to / FRAME_SIZE, .y2 = to % FRAME_SIZE,
+                        };
+                }
+            }
+        }
+    }
 
-        for (auto& move : single_moves) {
-            auto dest = piece + move;
-            auto jump_dest = dest + move;
+    return count;
+}
 
-            if (!in_board(dest)) {
+template <typename Layout>
+bitboard basic_board<Layout>::get_jump_component(int pos, const bitboard& occupied,
+    const bitboard& own, bitboard& jumpers) const
+{
+    // Flood fill over jump chains from pos. Most components are a cell or
+    // two, so cells are walked one by one through the jump table rather
+    // than shifting whole boards. The jumping piece stays on its starting
+    // cell meanwhile, chains may jump over it but never land there. Own
+    // pieces that can jump into the component are collected on the way.
+    std::uint8_t stack[SIZE * SIZE];
+    int stack_size = 0;
+
+    bitboard reached = bitboard::cell(pos);
+    stack[stack_size++] = static_cast<std::uint8_t>(pos);
+
+    while (stack_size) {
+        const auto& jumps = jump_table<SIZE>[stack[--stack_size]];
+
+        for (int i = 0; i < jumps.count; ++i) {
+            const auto& step = jumps.steps[i];
+            if (!occupied.test(step.over)) {
                 continue;
             }
 
-            if (_pieces[dest.first][dest.second] == 0) {
-                moves.push_back(board::move{
-                    .x1 = piece.first, .y1 = piece.second,
-                    .x2 = dest.first, .y2 = dest.second,
-                    });
+            if (!occupied.test(step.landing)) {
+                if (!reached.test(step.landing)) {
+                    reached.set(step.landing);
+                    stack[stack_size++] = step.landing;
+                }
             }
-            else if (in_board(jump_dest) && _pieces[jump_dest.first][jump_dest.second] == 0) {
-                rec_add_jump_moves(moves, visited, piece, jump_dest);
+            else if (own.test(step.landing)) {
+                jumpers.set(step.landing);
             }
         }
     }
 
-    return moves;
+    return reached;
 }
 
-int board::get_winner() const
+template <typename Layout>
+int basic_board<Layout>::get_winner() const
 {
-    if (_player_one_ok_pieces == _player_one_pieces.size()) return 1;
-    if (_player_two_ok_pieces == _player_two_pieces.size()) return 2;
+    if (_player_one_ok_pieces == _player_one_pieces.count) return 1;
+    if (_player_two_ok_pieces == _player_two_pieces.count) return 2;
 
     return 0;
 }
 
-std::int64_t board::get_heuristic_one() const
+template <typename Layout>
+std::int64_t basic_board<Layout>::get_heuristic_one() const
 {
     int winner = get_winner();
     if (winner == 1) return LLONG_MAX;
     else if (winner == 2) return LLONG_MIN;
 
-    return _heuristic_one;
+    return _terms_one.empty() ? _heuristic_one : _heuristic_one + get_terms(*_metric_one, _terms_one);
 }
 
-std::int64_t board::get_heuristic_two() const
+template <typename Layout>
+std::int64_t basic_board<Layout>::get_heuristic_two() const
 {
     int winner = get_winner();
     if (winner == 1) return LLONG_MAX;
     else if (winner == 2) return LLONG_MIN;
 
-    return _heuristic_two;
+    return _terms_two.empty() ? _heuristic_two : _heuristic_two + get_terms(*_metric_two, _terms_two);
+}
+
+// Distances of the player's pieces in slot order, from the corner the
+// player heads for
+template <typename Layout>
+void basic_board<Layout>::get_piece_distances(int player, const distance_tables<SIZE>& tables,
+    piece_distances& out) const
+{
+    const piece_list& list = player == 1 ? _player_one_pieces : _player_two_pieces;
+    const auto& corner = player == 1 ? tables.first_corner : tables.last_corner;
+
+    out.count = list.count;
+    for (int i = 0; i < list.count; ++i) {
+        int x = list.cells[i] / FRAME_SIZE;
+        int y = list.cells[i] % FRAME_SIZE;
+        out.distance[i] = static_cast<std::int32_t>(corner[x][y]);
+        out.in_camp[i] = camp_map<Layout>[x][y] == player;
+    }
+}
+
+// Terms of the second player's pieces minus those of the first player's,
+// the same way round as the distances
+template <typename Layout>
+std::int64_t basic_board<Layout>::get_terms(const distance_tables<SIZE>& tables,
+    const evaluation_terms& terms) const
+{
+    piece_distances pieces;
+
+    get_piece_distances(1, tables, pieces);
+    std::int64_t first = evaluate_terms(pieces, terms);
+    get_piece_distances(2, tables, pieces);
+    std::int64_t second = evaluate_terms(pieces, terms);
+
+    return second - first;
 }
 
-std::uint64_t board::hash_position() const
+template <typename Layout>
+void basic_board<Layout>::evaluate_moves(int player, int which_heuristic, const move* moves, int count,
+    std::int64_t* out) const
 {
-    std::uint64_t result = 0;
-    std::uint64_t multiplicand = 1;
+    assert(player == 1 || player == 2);
+    assert(which_heuristic == 1 || which_heuristic == 2);
+
+    const auto& tables = which_heuristic == 1 ? *_metric_one : *_metric_two;
+    const auto& terms = which_heuristic == 1 ? _terms_one : _terms_two;
+    const auto& corner = player == 1 ? tables.first_corner : tables.last_corner;
+    const piece_list& list = player == 1 ? _player_one_pieces : _player_two_pieces;
+    int ok_pieces = player == 1 ? _player_one_ok_pieces : _player_two_ok_pieces;
+    std::int64_t base = which_heuristic == 1 ? _heuristic_one : _heuristic_two;
+
+    // The first player's distances count against the heuristic
+    int sign = player == 1 ? -1 : 1;
+
+    for (int i = 0; i < count; ++i) {
+        const auto& move = moves[i];
+        out[i] = base + sign * (corner[move.x2][move.y2] - corner[move.x1][move.y1]);
+    }
 
-    for (int x = 0; x < BOARD_SIZE; ++x) {
-        for (int y = 0; y < BOARD_SIZE; ++y) {
-            result += multiplicand * static_cast<std::uint64_t>(_pieces[x][y]);
-            multiplicand *= 3;
+    if (!terms.empty()) {
+        piece_distances pieces;
+        get_piece_distances(3 - player, tables, pieces);
+        std::int64_t other_terms = evaluate_terms(pieces, terms);
+        get_piece_distances(player, tables, pieces);
+
+        // Moves are scored in chunks, so that their arrays stay on the stack
+        constexpr int CHUNK = 256;
+        std::int32_t slots[CHUNK];
+        std::int32_t distances[CHUNK];
+        std::int32_t in_camp[CHUNK];
+        std::int64_t penalties[CHUNK];
+
+        for (int start = 0; start < count; start += CHUNK) {
+            int chunk = std::min(CHUNK, count - start);
+            for (int i = 0; i < chunk; ++i) {
+                const auto& move = moves[start + i];
+                slots[i] = _piece_index[move.x1 * FRAME_SIZE + move.y1];
+                distances[i] = static_cast<std::int32_t>(corner[move.x2][move.y2]);
+                in_camp[i] = camp_map<Layout>[move.x2][move.y2] == player;
+            }
+
+            evaluate_terms(pieces, terms, piece_moves{ slots, distances, in_camp, chunk }, penalties);
+            for (int i = 0; i < chunk; ++i) {
+                out[start + i] += sign * (penalties[i] - other_terms);
+            }
         }
     }
 
-    return result;
+    // Only the player moving can complete its camp
+    for (int i = 0; i < count; ++i) {
+        const auto& move = moves[i];
+        int moved_ok = ok_pieces + (camp_map<Layout>[move.x2][move.y2] == player)
+            - (camp_map<Layout>[move.x1][move.y1] == player);
+        if (moved_ok == list.count) {
+            out[i] = player == 1 ? LLONG_MAX : LLONG_MIN;
+        }
+    }
+}
+
+template <typename Layout>
+std::uint64_t basic_board<Layout>::hash_position() const
+{
+    return _hash;
+}
+
+template <typename Layout>
+std::uint64_t basic_board<Layout>::hash_position(int player) const
+{
+    assert(player == 1 || player == 2);
+    return player == 2 ? _hash ^ SECOND_PLAYER_KEY : _hash;
 }
 
-void board::copy_position(std::uint8_t out[BOARD_SIZE][BOARD_SIZE])
+template <typename Layout>
+int basic_board<Layout>::get_pieces_outside_camp(int player) const
+{
+    assert(player == 1 || player == 2);
+
+    return player == 1 ? _player_one_pieces.count - _player_one_ok_pieces
+        : _player_two_pieces.count - _player_two_ok_pieces;
+}
+
+template <typename Layout>
+void basic_board<Layout>::copy_position(std::uint8_t out[SIZE][SIZE])
 {
     std::memcpy(out, _pieces, sizeof(_pieces));
 }
 
-bool board::compare_position(std::uint8_t in[BOARD_SIZE][BOARD_SIZE])
+template <typename Layout>
+bool basic_board<Layout>::compare_position(std::uint8_t in[SIZE][SIZE])
 {
     return std::memcmp(in, _pieces, sizeof(_pieces)) == 0;
 }
 
-void board::rec_add_jump_moves(std::vector<move>& out,
-    std::bitset<BOARD_SIZE* BOARD_SIZE>& visited,
-    std::pair<int, int> from, std::pair<int, int> pos) const
+template <typename Layout>
+bool basic_board<Layout>::check_invariants() const
 {
-    visited.set(to_pos(pos));
-    out.push_back(board::move{
-        .x1 = from.first, .y1 = from.second,
-        .x2 = pos.first, .y2 = pos.second,
-        });
+    std::int64_t heuristic_one = 0;
+    std::int64_t heuristic_two = 0;
+    std::uint64_t hash = 0;
+    int counts[2] = { 0, 0 };
+    int ok_pieces[2] = { 0, 0 };
+
+    for (int x = 0; x < SIZE; ++x) {
+        for (int y = 0; y < SIZE; ++y) {
+            int player = _pieces[x][y];
+            int pos = x * FRAME_SIZE + y;
+
+            if (_player_one_occupancy.test(pos) != (player == 1)
+                || _player_two_occupancy.test(pos) != (player == 2)) {
+                return false;
+            }
 
-    for (auto& move : single_moves) {
-        auto dest = pos + move;
-        auto jump_dest = dest + move;
+            if (!player) {
+                continue;
+            }
 
-        // We don't have to check if dest is in range
-        if (!in_board(jump_dest)) {
-            continue;
-        }
+            const piece_list& list = player == 1 ? _player_one_pieces : _player_two_pieces;
+            if (_piece_index[pos] >= list.count || list.cells[_piece_index[pos]] != pos) {
+                return false;
+            }
 
-        if (visited.test(to_pos(jump_dest))) {
-            continue;
-        }
+            ++counts[player - 1];
+            ok_pieces[player - 1] += camp_map<Layout>[x][y] == player;
+            hash ^= zobrist_key(x, y, player);
 
-        if (_pieces[dest.first][dest.second] && !_pieces[jump_dest.first][jump_dest.second]) {
-            rec_add_jump_moves(out, visited, from, jump_dest);
+            if (player == 1) {
+                heuristic_one -= _metric_one->first_corner[x][y];
+                heuristic_two -= _metric_two->first_corner[x][y];
+            }
+            else {
+                heuristic_one += _metric_one->last_corner[x][y];
+                heuristic_two += _metric_two->last_corner[x][y];
+            }
         }
     }
+
+    // Every piece was found in its list above, so equal counts mean the
+    // lists and bitboards hold nothing else
+    return counts[0] == _player_one_pieces.count && counts[1] == _player_two_pieces.count
+        && counts[0] == _player_one_occupancy.count() && counts[1] == _player_two_occupancy.count()
+        && ok_pieces[0] == _player_one_ok_pieces && ok_pieces[1] == _player_two_ok_pieces
+        && heuristic_one == _heuristic_one && heuristic_two == _heuristic_two
+        && hash == _hash;
 }
 
+template class basic_board<halma_16>;
+template class basic_board<halma_10>;
+template class basic_board<halma_8>;
@@ -1,22 +1,65 @@
 #pragma once
-#include <bitset>
+#include "bitboard.hpp"
+#include "evaluation.hpp"
+#include "metrics.hpp"
+
+#include <array>
 #include <cstdint>
-#include <functional>
-#include <utility>
 #include <vector>
 
-#define BOARD_SIZE              16
+// Size of a square board and the shape of its camps. Row x of the first
+// player's camp, in the (0, 0) corner, covers the cells with y below
+// CAMP_ROWS[x]. The second player's camp is its mirror image in the
+// opposite corner. The first player heads for the first camp.
+template <int Size, int... CampRows>
+struct board_layout {
+    static constexpr int SIZE = Size;
+    static constexpr std::array<int, sizeof...(CampRows)> CAMP_ROWS = { CampRows... };
+
+    static_assert(Size >= 4 && Size <= FRAME_SIZE);
+};
+
+// The variants we play, 19 pieces on 16x16, 15 on 10x10 and 10 on 8x8
+using halma_16 = board_layout<16, 5, 5, 4, 3, 2>;
+using halma_10 = board_layout<10, 5, 4, 3, 2, 1>;
+using halma_8 = board_layout<8, 4, 3, 2, 1>;
 
-class board {
+// Moves look the same on every board
+struct board_move {
+    int x1, y1;
+    int x2, y2;
+};
+
+template <typename Layout>
+class basic_board {
 public:
-    struct move {
-        int x1, y1;
-        int x2, y2;
-    };
+    using move = board_move;
+
+    static constexpr int SIZE = Layout::SIZE;
 
-    board();
-    void set_metric_one(std::function<std::int64_t(move)> metric);
-    void set_metric_two(std::function<std::int64_t(move)> metric);
+    // Upper bound on the number of legal moves, whatever the armies. A jump
+    // keeps the parity of both coordinates, so pieces only jump to empty
+    // cells of their own parity class. A class of n cells holding p pieces
+    // gives at most p * (n - p) <= n^2 / 4 jumps, and with classes of at
+    // most h^2 cells, h = (SIZE + 1) / 2, all four give at most h^4. Steps
+    // use each edge of the king graph at most once. Move buffers of every
+    // search hold this many moves per ply.
+    static constexpr int MAX_MOVES = SIZE * SIZE * SIZE * SIZE / 8;
+
+    static_assert(((SIZE + 1) / 2) * ((SIZE + 1) / 2) * ((SIZE + 1) / 2) * ((SIZE + 1) / 2)
+        + 2 * SIZE * (SIZE - 1) + 2 * (SIZE - 1) * (SIZE - 1) <= MAX_MOVES,
+        "MAX_MOVES must cover all jumps and steps of any position");
+
+    basic_board();
+    void set_metric_one(metric_kind metric);
+    void set_metric_two(metric_kind metric);
+    // Tables of any other evaluation, like tuned ones. They are not copied,
+    // the caller keeps them alive as long as the board and its copies.
+    void set_tables_one(const distance_tables<SIZE>* tables);
+    void set_tables_two(const distance_tables<SIZE>* tables);
+    // Terms added to the distances of the pieces, none by default
+    void set_terms_one(const evaluation_terms& terms);
+    void set_terms_two(const evaluation_terms& terms);
 
     void set_piece(int x, int y, int player);
     int get_piece(int x, int y) const;
@@ -27,28 +70,71 @@ public:
     void undo_move(move move) { undo_move(move.x1, move.y1, move.x2, move.y2); }
 
     std::vector<move> get_legal_moves(int player) const;
+    int get_legal_moves(int player, move* out) const;
     int get_winner() const;
+    // Pieces of the player not yet in the camp it heads for
+    int get_pieces_outside_camp(int player) const;
     std::int64_t get_heuristic_one() const;
     std::int64_t get_heuristic_two() const;
+    // Heuristic 1 or 2 after every one of the player's moves, as
+    // get_heuristic_one/two would return it with the move made. The moves
+    // are not made, so scoring all children of a node costs less than
+    // making and evaluating them one by one.
+    void evaluate_moves(int player, int which_heuristic, const move* moves, int count,
+        std::int64_t* out) const;
 
     std::uint64_t hash_position() const;
+    // Hash of the position with the given player to move
+    std::uint64_t hash_position(int player) const;
 
-    void copy_position(std::uint8_t out[BOARD_SIZE][BOARD_SIZE]);
-    bool compare_position(std::uint8_t in[BOARD_SIZE][BOARD_SIZE]);
+    void copy_position(std::uint8_t out[SIZE][SIZE]);
+    bool compare_position(std::uint8_t in[SIZE][SIZE]);
+
+    // Recomputes everything kept up to date by the moves from the cells
+    // alone, returns false if the piece lists, occupancy, camp counts,
+    // heuristic sums or hash differ. Slow, for checks only.
+    bool check_invariants() const;
 
 private:
-    std::uint8_t _pieces[BOARD_SIZE][BOARD_SIZE];
-    std::function<std::int64_t(move)> _metric_one;
-    std::function<std::int64_t(move)> _metric_two;
-    std::vector<std::pair<int, int>> _player_one_pieces;
-    std::vector<std::pair<int, int>> _player_two_pieces;
+    // Frame cells of one player's pieces in no particular order.
+    // _piece_index maps an occupied cell back to its slot, so a piece is
+    // found, moved and removed in constant time.
+    struct piece_list {
+        std::uint8_t cells[SIZE * SIZE];
+        int count;
+    };
+
+    std::uint8_t _pieces[SIZE][SIZE];
+    const distance_tables<SIZE>* _metric_one;
+    const distance_tables<SIZE>* _metric_two;
+    evaluation_terms _terms_one;
+    evaluation_terms _terms_two;
+    piece_list _player_one_pieces;
+    piece_list _player_two_pieces;
+    std::uint8_t _piece_index[FRAME_SIZE * FRAME_SIZE];
+    bitboard _player_one_occupancy;
+    bitboard _player_two_occupancy;
     int _player_one_ok_pieces;
     int _player_two_ok_pieces;
 
     std::int64_t _heuristic_one;
     std::int64_t _heuristic_two;
+    std::uint64_t _hash;
 
-    void rec_add_jump_moves(std::vector<move>& out,
-        std::bitset<BOARD_SIZE * BOARD_SIZE>& visited,
-        std::pair<int, int> from, std::pair<int, int> pos) const;
+    void add_to_list(piece_list& list, int pos);
+    void remove_from_list(piece_list& list, int pos);
+    void move_in_list(piece_list& list, int from, int to);
+    void recompute_heuristics();
+    void get_piece_distances(int player, const distance_tables<SIZE>& tables,
+        piece_distances& out) const;
+    std::int64_t get_terms(const distance_tables<SIZE>& tables, const evaluation_terms& terms) const;
+    bitboard get_jump_component(int pos, const bitboard& occupied,
+        const bitboard& own, bitboard& jumpers) const;
 };
+
+// Every size we play is compiled once, in board.cpp
+extern template class basic_board<halma_16>;
+extern template class basic_board<halma_10>;
+extern template class basic_board<halma_8>;
+
+using board = basic_board<halma_16>;
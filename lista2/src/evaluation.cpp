@@ -0,0 +1,218 @@
+#include "evaluation.hpp"
+
+#include <climits>
+
+// The AVX2 kernel is compiled in on x86 whatever the build targets, GCC
+// and Clang compile just that function for AVX2, and it is used only on
+// CPUs that have it. MSVC has no such attribute and needs /arch:AVX2.
+#if defined(__AVX2__)
+#define EVALUATION_AVX2_KERNEL
+#define EVALUATION_AVX2_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EVALUATION_AVX2_KERNEL
+#define EVALUATION_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#ifdef EVALUATION_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+// What every move of a batch starts from: the sums over all pieces and the
+// two farthest and two closest pieces, so that the spread without the moved
+// piece is known whichever piece moves. Sums of distances fit in 32 bits.
+struct pieces_summary {
+    std::int32_t sum;
+    std::int32_t camp;
+    std::int32_t high;
+    std::int32_t second_high;
+    int high_slot;
+    std::int32_t low;
+    std::int32_t second_low;
+    int low_slot;
+};
+
+static pieces_summary summarize(const piece_distances& pieces)
+{
+    pieces_summary summary{
+        .sum = 0,
+        .camp = 0,
+        .high = INT32_MIN,
+        .second_high = INT32_MIN,
+        .high_slot = -1,
+        .low = INT32_MAX,
+        .second_low = INT32_MAX,
+        .low_slot = -1,
+    };
+
+    for (int i = 0; i < pieces.count; ++i) {
+        std::int32_t distance = pieces.distance[i];
+        summary.sum += distance;
+        summary.camp += pieces.in_camp[i];
+
+        if (distance > summary.high) {
+            summary.second_high = summary.high;
+            summary.high = distance;
+            summary.high_slot = i;
+        }
+        else if (distance > summary.second_high) {
+            summary.second_high = distance;
+        }
+
+        if (distance < summary.low) {
+            summary.second_low = summary.low;
+            summary.low = distance;
+            summary.low_slot = i;
+        }
+        else if (distance < summary.second_low) {
+            summary.second_low = distance;
+        }
+    }
+
+    return summary;
+}
+
+static std::int64_t combine_terms(const evaluation_terms& terms, std::int64_t spread,
+    std::int64_t stragglers, std::int64_t camp)
+{
+    return terms.spread * spread + terms.straggler * stragglers - terms.camp * camp;
+}
+
+// A piece lags behind if its distance is more than the margin above the
+// average, compared multiplied by the piece count to stay in integers
+static std::int32_t straggler_threshold(const evaluation_terms& terms, std::int32_t sum, int count)
+{
+    return sum + terms.straggler_margin * count;
+}
+
+static std::int64_t evaluate_move(const piece_distances& pieces, const pieces_summary& summary,
+    const evaluation_terms& terms, int slot, std::int32_t distance, std::int32_t in_camp)
+{
+    int count = pieces.count;
+    std::int32_t sum = summary.sum - pieces.distance[slot] + distance;
+    std::int32_t camp = summary.camp - pieces.in_camp[slot] + in_camp;
+    std::int32_t threshold = straggler_threshold(terms, sum, count);
+
+    std::int32_t high = slot == summary.high_slot ? summary.second_high : summary.high;
+    std::int32_t low = slot == summary.low_slot ? summary.second_low : summary.low;
+    high = distance > high ? distance : high;
+    low = distance < low ? distance : low;
+
+    // The moved piece is counted where it goes instead of where it stood
+    std::int32_t stragglers = (distance * count > threshold) - (pieces.distance[slot] * count > threshold);
+    for (int i = 0; i < count; ++i) {
+        stragglers += pieces.distance[i] * count > threshold;
+    }
+
+    return combine_terms(terms, static_cast<std::int64_t>(high) - low, stragglers, camp);
+}
+
+std::int64_t evaluate_terms(const piece_distances& pieces, const evaluation_terms& terms)
+{
+    if (pieces.count == 0) {
+        return 0;
+    }
+
+    // The pieces as they are score like moving a piece to where it stands
+    return evaluate_move(pieces, summarize(pieces), terms, 0, pieces.distance[0], pieces.in_camp[0]);
+}
+
+static void evaluate_terms_scalar(const piece_distances& pieces, const evaluation_terms& terms,
+    const piece_moves& moves, std::int64_t* out)
+{
+    auto summary = summarize(pieces);
+    for (int m = 0; m < moves.count; ++m) {
+        out[m] = evaluate_move(pieces, summary, terms, moves.slot[m], moves.distance[m], moves.in_camp[m]);
+    }
+}
+
+#ifdef EVALUATION_AVX2_KERNEL
+
+// Eight moves are scored at once, one in every lane. The moved piece is
+// gathered from the pieces, the spread comes from the summary and every
+// piece is compared with the straggler thresholds of all eight moves.
+EVALUATION_AVX2_TARGET
+static void evaluate_terms_avx2(const piece_distances& pieces, const evaluation_terms& terms,
+    const piece_moves& moves, std::int64_t* out)
+{
+    int count = pieces.count;
+    auto summary = summarize(pieces);
+
+    const __m256i count_vector = _mm256_set1_epi32(count);
+    const __m256i margin = _mm256_set1_epi32(terms.straggler_margin * count);
+    const __m256i high_slot = _mm256_set1_epi32(summary.high_slot);
+    const __m256i low_slot = _mm256_set1_epi32(summary.low_slot);
+    const __m256i high = _mm256_set1_epi32(summary.high);
+    const __m256i second_high = _mm256_set1_epi32(summary.second_high);
+    const __m256i low = _mm256_set1_epi32(summary.low);
+    const __m256i second_low = _mm256_set1_epi32(summary.second_low);
+
+    alignas(32) std::int32_t spreads[8];
+    alignas(32) std::int32_t stragglers[8];
+    alignas(32) std::int32_t camps[8];
+
+    int m = 0;
+    for (; m + 8 <= moves.count; m += 8) {
+        __m256i slot = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(moves.slot + m));
+        __m256i distance = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(moves.distance + m));
+        __m256i in_camp = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(moves.in_camp + m));
+        __m256i old_distance = _mm256_i32gather_epi32(pieces.distance, slot, 4);
+        __m256i old_in_camp = _mm256_i32gather_epi32(pieces.in_camp, slot, 4);
+
+        __m256i sum = _mm256_add_epi32(_mm256_set1_epi32(summary.sum), _mm256_sub_epi32(distance, old_distance));
+        __m256i camp = _mm256_add_epi32(_mm256_set1_epi32(summary.camp), _mm256_sub_epi32(in_camp, old_in_camp));
+        __m256i threshold = _mm256_add_epi32(sum, margin);
+
+        __m256i moved_high = _mm256_blendv_epi8(high, second_high, _mm256_cmpeq_epi32(slot, high_slot));
+        __m256i moved_low = _mm256_blendv_epi8(low, second_low, _mm256_cmpeq_epi32(slot, low_slot));
+        moved_high = _mm256_max_epi32(moved_high, distance);
+        moved_low = _mm256_min_epi32(moved_low, distance);
+
+        // Comparisons are -1 where true
+        __m256i behind = _mm256_sub_epi32(
+            _mm256_cmpgt_epi32(_mm256_mullo_epi32(old_distance, count_vector), threshold),
+            _mm256_cmpgt_epi32(_mm256_mullo_epi32(distance, count_vector), threshold));
+        for (int i = 0; i < count; ++i) {
+            behind = _mm256_sub_epi32(behind,
+                _mm256_cmpgt_epi32(_mm256_set1_epi32(pieces.distance[i] * count), threshold));
+        }
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(spreads), _mm256_sub_epi32(moved_high, moved_low));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(stragglers), behind);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(camps), camp);
+
+        for (int lane = 0; lane < 8; ++lane) {
+            out[m + lane] = combine_terms(terms, spreads[lane], stragglers[lane], camps[lane]);
+        }
+    }
+
+    for (; m < moves.count; ++m) {
+        out[m] = evaluate_move(pieces, summary, terms, moves.slot[m], moves.distance[m], moves.in_camp[m]);
+    }
+}
+
+#endif
+
+bool evaluation_uses_avx2()
+{
+#if defined(__AVX2__)
+    return true;
+#elif defined(EVALUATION_AVX2_KERNEL)
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void evaluate_terms(const piece_distances& pieces, const evaluation_terms& terms,
+    const piece_moves& moves, std::int64_t* out)
+{
+#ifdef EVALUATION_AVX2_KERNEL
+    if (evaluation_uses_avx2()) {
+        evaluate_terms_avx2(pieces, terms, moves, out);
+        return;
+    }
+#endif
+
+    evaluate_terms_scalar(pieces, terms, moves, out);
+}
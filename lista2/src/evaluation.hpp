@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+
+// Terms of the heuristic besides the distance of every piece from the
+// corner it heads for. All of them are penalties of one player's pieces in
+// the units of its distance tables, so that a term is worth as much as
+// moving pieces that far.
+struct evaluation_terms {
+    // Per unit of distance between the leading and the last piece, since
+    // pieces far apart cannot jump over each other
+    std::int32_t spread = 0;
+    // Per piece more than straggler_margin behind the average piece
+    std::int32_t straggler = 0;
+    std::int32_t straggler_margin = 0;
+    // Bonus per piece already in the goal camp
+    std::int32_t camp = 0;
+
+    bool empty() const { return spread == 0 && straggler == 0 && camp == 0; }
+};
+
+// One player's pieces as struct of arrays: the table distance of every
+// piece from its corner and whether it stands in its goal camp
+struct piece_distances {
+    static constexpr int CAPACITY = 256;
+
+    std::int32_t distance[CAPACITY];
+    std::int32_t in_camp[CAPACITY];
+    int count;
+};
+
+// Moves of single pieces as struct of arrays: the slot of the moved piece
+// and the distance and camp flag of the cell it moves to
+struct piece_moves {
+    const std::int32_t* slot;
+    const std::int32_t* distance;
+    const std::int32_t* in_camp;
+    int count;
+};
+
+// Penalty of the terms for the pieces as they are
+std::int64_t evaluate_terms(const piece_distances& pieces, const evaluation_terms& terms);
+
+// Penalty of the terms after every one of the moves, written to out. On
+// CPUs with AVX2 eight moves are scored at once.
+void evaluate_terms(const piece_distances& pieces, const evaluation_terms& terms,
+    const piece_moves& moves, std::int64_t* out);
+
+// Whether the batch above runs the AVX2 kernel on this CPU
+bool evaluation_uses_avx2();
@@ -1,60 +1,151 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "board.hpp"
 #include "minimax.hpp"
+#include "position_book.hpp"
 
-static std::int64_t first_strategy(board::move m)
-{
-    return std::abs(m.x1 - m.x2) + std::abs(m.y1 - m.y2);
-}
+// Depth of the search used to measure how it scales with threads
+static const int SCALING_DEPTH = 5;
 
-static std::int64_t second_strategy(board::move m)
+template <typename Layout>
+static void run_scaling(const basic_board<Layout>& brd, int max_thread_count)
 {
-    return static_cast<std::int64_t>(std::round(1000.0 * std::sqrt(
-        (m.x1 - m.x2) * (m.x1 - m.x2) + (m.y1 - m.y2) * (m.y1 - m.y2))));
+    std::chrono::steady_clock::duration single_thread_time;
+
+    for (int thread_count = 1; thread_count <= max_thread_count; ++thread_count) {
+        basic_board<Layout> copy = brd;
+        basic_minimax<Layout> player(1, 1);
+        player.set_depth(SCALING_DEPTH);
+        player.set_thread_count(thread_count);
+
+        auto start = std::chrono::steady_clock::now();
+        int nodes = player.make_next_move(copy);
+        auto duration = std::chrono::steady_clock::now() - start;
+
+        if (thread_count == 1) {
+            single_thread_time = duration;
+        }
+
+        std::cerr << "Watki: " << thread_count
+            << ", czas: " << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+            << ", wezly: " << nodes
+            << ", przyspieszenie: " << static_cast<double>(single_thread_time.count()) / duration.count()
+            << std::endl;
+    }
 }
 
-static std::int64_t third_strategy(board::move m)
+struct game_options {
+    int thread_count = 1;
+    bool scaling = false;
+    bool pondering = false;
+    const char* stats_path = nullptr;
+    metric_kind metric = metric_kind::CHEBYSHEV;
+    // Tables written by the tune tool, used instead of the metric
+    const char* weights_path = nullptr;
+    evaluation_terms terms;
+    std::vector<std::unique_ptr<position_book>> books;
+};
+
+// Plays a whole game between two minimax players on a board read from
+// the standard input
+template <typename Layout>
+static int play(const game_options& options)
 {
-    return std::max(std::abs(m.x1 - m.x2), std::abs(m.y1 - m.y2));
-}
+    basic_board<Layout> brd;
+    brd.set_metric_one(options.metric);
+    brd.set_metric_two(options.metric);
 
-int main() {
-    board brd;
-    brd.set_metric_one(third_strategy);
-    brd.set_metric_two(third_strategy);
+    distance_tables<Layout::SIZE> weights;
+    if (options.weights_path) {
+        std::ifstream weights_file(options.weights_path);
+        if (!read_distance_tables(weights_file, weights)) {
+            std::cerr << "Nie mozna wczytac wag z pliku " << options.weights_path << std::endl;
+            return 1;
+        }
 
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
+        brd.set_tables_one(&weights);
+        brd.set_tables_two(&weights);
+    }
+
+    brd.set_terms_one(options.terms);
+    brd.set_terms_two(options.terms);
+
+    for (int y = 0; y < Layout::SIZE; ++y) {
+        for (int x = 0; x < Layout::SIZE; ++x) {
             int tmp;
             std::cin >> tmp;
             brd.set_piece(x, y, tmp);
         }
     }
 
-    auto moves = brd.get_legal_moves(1);
+    if (options.scaling) {
+        run_scaling(brd, options.thread_count);
+        return 0;
+    }
 
-    minimax player1(1, 1);
+    basic_minimax<Layout> player1(1, 1);
     player1.set_depth(3);
-    minimax player2(2, 2);
+    player1.set_thread_count(options.thread_count);
+    player1.set_pondering(options.pondering);
+    basic_minimax<Layout> player2(2, 2);
     player2.set_depth(3);
+    player2.set_thread_count(options.thread_count);
+    player2.set_pondering(options.pondering);
+
+    for (const auto& book : options.books) {
+        player1.add_book(book.get());
+        player2.add_book(book.get());
+    }
+
+    // Statistics of every search as one JSON object per line
+    std::ofstream stats_file;
+    if (options.stats_path) {
+        stats_file.open(options.stats_path);
+        player1.set_profiling(true);
+        player2.set_profiling(true);
+    }
+
+    int ply = 0;
+    auto write_stats = [&](int player, const basic_minimax<Layout>& engine) {
+        if (stats_file.is_open()) {
+            stats_file << "{\"ply\": " << ply << ", \"player\": " << player
+                << ", \"search\": " << engine.get_search_stats().to_json() << "}\n";
+        }
+        ++ply;
+    };
 
     auto start = std::chrono::steady_clock::now();
 
     int turn_counter = 0;
     std::uint64_t total_nodes = 0;
     while (!brd.get_winner()) {
+        // A player left with no move ends the game without a winner
         int nodes = 0;
-        nodes += player1.make_next_move(brd);
+        int searched = player1.make_next_move(brd);
+        if (searched < 0) break;
+        nodes += searched;
+        write_stats(1, player1);
         if (brd.get_winner()) continue;
-        nodes += player2.make_next_move(brd);
+        searched = player2.make_next_move(brd);
+        if (searched < 0) break;
+        nodes += searched;
+        write_stats(2, player2);
         std::cerr << "Zakonczono ture " << (++turn_counter) << ", wezly: " << nodes << std::endl;
         total_nodes += nodes;
     }
 
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
+    for (int y = 0; y < Layout::SIZE; ++y) {
+        for (int x = 0; x < Layout::SIZE; ++x) {
             std::cout << brd.get_piece(x, y) << ' ';
         }
         std::cout << std::endl;
@@ -72,5 +163,95 @@ int main() {
         << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
         << std::endl;
     std::cerr << "Odwiedzone wezly: " << total_nodes << std::endl;
+
+    for (auto* player : { &player1, &player2 }) {
+        auto& stats = player->get_table_stats();
+        std::cerr << "Tablica transpozycji: zapytania " << stats.probes
+            << ", trafienia " << stats.hits
+            << " (" << (stats.probes ? 100.0 * stats.hits / stats.probes : 0.0) << "%)"
+            << ", odciecia " << stats.cutoffs << std::endl;
+    }
+
+    if (!options.books.empty()) {
+        for (auto* player : { &player1, &player2 }) {
+            auto& stats = player->get_book_stats();
+            std::cerr << "Ruchy z ksiegi: " << stats.hits
+                << " z " << stats.probes << std::endl;
+        }
+    }
+
+    if (options.pondering) {
+        for (auto* player : { &player1, &player2 }) {
+            auto& stats = player->get_ponder_stats();
+            std::cerr << "Przewidywanie ruchow przeciwnika: trafione " << stats.hits
+                << " z " << stats.predictions << std::endl;
+        }
+    }
+
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    game_options options;
+    int size = halma_16::SIZE;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.thread_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--scaling") == 0) {
+            options.scaling = true;
+        }
+        else if (std::strcmp(argv[i], "--ponder") == 0) {
+            options.pondering = true;
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            options.stats_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+            auto book = std::make_unique<position_book>();
+            if (!book->open(argv[++i])) {
+                std::cerr << "Nie mozna otworzyc ksiegi " << argv[i] << std::endl;
+                return 1;
+            }
+
+            options.books.push_back(std::move(book));
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            // Camps of the smaller boards are triangles, which only the
+            // Manhattan metric sees as equally close to the corner
+            std::string metric = argv[++i];
+            if (metric == "manhattan") options.metric = metric_kind::MANHATTAN;
+            else if (metric == "euclidean") options.metric = metric_kind::EUCLIDEAN;
+            else if (metric == "chebyshev") options.metric = metric_kind::CHEBYSHEV;
+            else {
+                std::cerr << "Nieznana metryka " << metric << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+            options.weights_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--terms") == 0 && i + 1 < argc) {
+            // SPREAD,STRAGGLER,MARGIN,CAMP in units of the metric
+            auto& terms = options.terms;
+            if (std::sscanf(argv[++i], "%d,%d,%d,%d", &terms.spread, &terms.straggler,
+                &terms.straggler_margin, &terms.camp) != 4) {
+                std::cerr << "Bledne wagi skladnikow " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    switch (size) {
+    case halma_16::SIZE: return play<halma_16>(options);
+    case halma_10::SIZE: return play<halma_10>(options);
+    case halma_8::SIZE: return play<halma_8>(options);
+    default:
+        std::cerr << "Nieobslugiwany rozmiar planszy " << size << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,293 @@
+#include "mcts.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <thread>
+
+// 2^20 nodes, 20 MB per player
+static constexpr std::uint32_t NODE_CAPACITY = 1 << 20;
+
+// Iterations of a search when no other limit is set
+static constexpr int DEFAULT_ITERATION_LIMIT = 10000;
+
+// Playouts are cut after this many plies and scored by the heuristic.
+// With the sampling policy below longer playouts mostly add noise.
+static constexpr int PLAYOUT_PLIES = 4;
+
+// Random moves a playout draws per ply, the one moving the piece farthest
+// towards its corner is played
+static constexpr int PLAYOUT_SAMPLES = 4;
+
+static constexpr double EXPLORATION = 1.4;
+
+static inline int next_player(int player)
+{
+    return player == 1 ? 2 : 1;
+}
+
+mcts::mcts(int which_player, int which_heuristic)
+    : _player(which_player)
+    , _heuristic(which_heuristic)
+    , _time_limit(0)
+    , _iteration_limit(0)
+    , _thread_count(1)
+    , _nodes(std::make_unique<node[]>(NODE_CAPACITY))
+    , _node_count(0)
+    , _tree_full(false)
+    , _iterations(0)
+    , _root_score(0)
+{
+}
+
+void mcts::set_time_limit(std::chrono::milliseconds limit)
+{
+    _time_limit = limit;
+}
+
+void mcts::set_iteration_limit(int iterations)
+{
+    _iteration_limit = iterations;
+}
+
+void mcts::set_thread_count(int thread_count)
+{
+    assert(thread_count >= 1);
+    _thread_count = thread_count;
+}
+
+std::int64_t mcts::get_heuristic(const board& board) const
+{
+    std::int64_t score = _heuristic == 1 ? board.get_heuristic_one() : board.get_heuristic_two();
+    if (_player == 1) {
+        return score;
+    }
+
+    // A win of the second player is LLONG_MIN, which cannot be negated
+    return score == LLONG_MIN ? LLONG_MAX : -score;
+}
+
+int mcts::make_next_move(board& board)
+{
+    if (board.get_winner() || board.get_legal_moves(_player).empty()) {
+        return -1;
+    }
+
+    node& root = _nodes[0];
+    root.visits = 0;
+    root.score = 0;
+    root.state = LEAF;
+    root.child_count = 0;
+    _node_count = 1;
+    _tree_full = false;
+    _iterations = 0;
+    _deadline = std::chrono::steady_clock::now() + _time_limit;
+    _root_score = get_heuristic(board);
+
+    std::vector<::board> boards(_thread_count, board);
+    std::vector<std::thread> helpers;
+    std::random_device rd;
+
+    auto run = [&](int thread_index) {
+        search_context context{
+            .random = std::mt19937_64(rd() + thread_index),
+            .path = {},
+            .moves = std::vector<board::move>(board::MAX_MOVES),
+            .playout_moves = {},
+        };
+        search(boards[thread_index], context);
+    };
+
+    for (int i = 1; i < _thread_count; ++i) {
+        helpers.emplace_back(run, i);
+    }
+    run(0);
+
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    // The most visited move is the most reliable one
+    std::uint32_t best = root.first_child;
+    for (std::uint32_t i = 1; i < root.child_count; ++i) {
+        const node& child = _nodes[root.first_child + i];
+        if (child.visits > _nodes[best].visits
+            || (child.visits == _nodes[best].visits && child.score > _nodes[best].score)) {
+            best = root.first_child + i;
+        }
+    }
+
+    const node& chosen = _nodes[best];
+    board.move_piece(chosen.x1, chosen.y1, chosen.x2, chosen.y2);
+
+    // Threads that found the limit reached still counted themselves
+    return _iteration_limit > 0 ? std::min(_iterations.load(), _iteration_limit) : _iterations.load();
+}
+
+void mcts::search(board& board, search_context& context)
+{
+    int iteration_limit = _iteration_limit > 0 ? _iteration_limit
+        : _time_limit.count() > 0 ? INT_MAX : DEFAULT_ITERATION_LIMIT;
+
+    // The root is expanded before the threads split up, every later
+    // iteration walks down to a leaf, expands it on its second visit and
+    // plays out from there
+    if (_nodes[0].state.load(std::memory_order_acquire) != EXPANDED) {
+        expand(0, board, _player, context);
+    }
+    while (_nodes[0].state.load(std::memory_order_acquire) != EXPANDED) {
+        std::this_thread::yield();
+    }
+
+    while ((_time_limit.count() == 0 || std::chrono::steady_clock::now() < _deadline)
+        && _iterations++ < iteration_limit) {
+        std::uint32_t index = 0;
+        int player = _player;
+        context.path.clear();
+        context.path.push_back(0);
+        _nodes[0].visits.fetch_add(1, std::memory_order_relaxed);
+
+        while (true) {
+            node& current = _nodes[index];
+
+            if (current.state.load(std::memory_order_acquire) != EXPANDED) {
+                if (board.get_winner() || current.visits.load(std::memory_order_relaxed) < 2
+                    || !expand(index, board, player, context)) {
+                    break;
+                }
+            }
+
+            if (current.child_count == 0) {
+                break;
+            }
+
+            index = select_child(current);
+            node& child = _nodes[index];
+            child.visits.fetch_add(1, std::memory_order_relaxed);
+            board.move_piece(child.x1, child.y1, child.x2, child.y2);
+            context.path.push_back(index);
+            player = next_player(player);
+        }
+
+        int tree_depth = static_cast<int>(context.path.size()) - 1;
+        int reward = playout(board, player, tree_depth, context);
+
+        // Nodes at odd depths are moves of the searching player
+        for (int depth = tree_depth; depth >= 1; --depth) {
+            node& visited = _nodes[context.path[depth]];
+            visited.score.fetch_add(depth % 2 == 1 ? reward : 2 - reward, std::memory_order_relaxed);
+            board.undo_move(visited.x1, visited.y1, visited.x2, visited.y2);
+        }
+    }
+}
+
+bool mcts::expand(std::uint32_t index, const board& board, int player, search_context& context)
+{
+    node& parent = _nodes[index];
+
+    // Another thread expanding the same node, or the arena being full,
+    // turns this visit into a playout from the leaf
+    node_state expected = LEAF;
+    if (_tree_full.load(std::memory_order_relaxed)
+        || !parent.state.compare_exchange_strong(expected, EXPANDING, std::memory_order_acquire)) {
+        return parent.state.load(std::memory_order_acquire) == EXPANDED;
+    }
+
+    int move_count = board.get_legal_moves(player, context.moves.data());
+    std::uint32_t first = _node_count.fetch_add(move_count, std::memory_order_relaxed);
+
+    if (first + move_count > NODE_CAPACITY) {
+        _tree_full = true;
+        parent.state.store(LEAF, std::memory_order_release);
+        return false;
+    }
+
+    for (int i = 0; i < move_count; ++i) {
+        const auto& move = context.moves[i];
+        node& child = _nodes[first + i];
+
+        child.visits.store(0, std::memory_order_relaxed);
+        child.score.store(0, std::memory_order_relaxed);
+        child.state.store(LEAF, std::memory_order_relaxed);
+        child.x1 = static_cast<std::uint8_t>(move.x1);
+        child.y1 = static_cast<std::uint8_t>(move.y1);
+        child.x2 = static_cast<std::uint8_t>(move.x2);
+        child.y2 = static_cast<std::uint8_t>(move.y2);
+        child.child_count = 0;
+    }
+
+    parent.first_child = first;
+    parent.child_count = static_cast<std::uint16_t>(move_count);
+    parent.state.store(EXPANDED, std::memory_order_release);
+    return true;
+}
+
+std::uint32_t mcts::select_child(const node& parent) const
+{
+    // UCT, children nobody has visited yet go first
+    double log_visits = std::log(std::max<std::uint32_t>(1, parent.visits.load(std::memory_order_relaxed)));
+    std::uint32_t best = parent.first_child;
+    double best_value = -1.0;
+
+    for (std::uint32_t i = 0; i < parent.child_count; ++i) {
+        const node& child = _nodes[parent.first_child + i];
+        std::uint32_t visits = child.visits.load(std::memory_order_relaxed);
+
+        if (visits == 0) {
+            return parent.first_child + i;
+        }
+
+        double value = child.score.load(std::memory_order_relaxed) / (2.0 * visits)
+            + EXPLORATION * std::sqrt(log_visits / visits);
+
+        if (value > best_value) {
+            best_value = value;
+            best = parent.first_child + i;
+        }
+    }
+
+    return best;
+}
+
+int mcts::playout(board& board, int player, int tree_depth, search_context& context)
+{
+    // Both players make the same number of moves counted from the root,
+    // the result is whether the searching player gained on the opponent
+    int plies = PLAYOUT_PLIES + tree_depth % 2;
+    context.playout_moves.clear();
+
+    for (int ply = 0; ply < plies && !board.get_winner(); ++ply) {
+        int move_count = board.get_legal_moves(player, context.moves.data());
+        if (move_count == 0) {
+            break;
+        }
+
+        // Player one heads for the (0, 0) corner, player two away from it
+        int direction = player == 1 ? 1 : -1;
+        board::move best = context.moves[context.random() % move_count];
+        int best_gain = direction * (best.x1 + best.y1 - best.x2 - best.y2);
+
+        for (int sample = 1; sample < PLAYOUT_SAMPLES; ++sample) {
+            const auto& move = context.moves[context.random() % move_count];
+            int gain = direction * (move.x1 + move.y1 - move.x2 - move.y2);
+            if (gain > best_gain) {
+                best = move;
+                best_gain = gain;
+            }
+        }
+
+        board.move_piece(best);
+        context.playout_moves.push_back(best);
+        player = next_player(player);
+    }
+
+    std::int64_t score = get_heuristic(board);
+    int reward = score > _root_score ? 2 : score == _root_score ? 1 : 0;
+
+    for (auto it = context.playout_moves.rbegin(); it != context.playout_moves.rend(); ++it) {
+        board.undo_move(*it);
+    }
+
+    return reward;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "board.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Monte Carlo tree search player with the same interface as minimax.
+// All threads grow one shared tree, whose nodes come from an arena
+// allocated once per player. A thread counts its visit of a node on the way
+// down and adds the result only after the playout. Until then the visit
+// counts as a loss (virtual loss), which steers other threads elsewhere.
+class mcts {
+public:
+    mcts(int which_player, int which_heuristic);
+
+    void set_time_limit(std::chrono::milliseconds limit);
+    void set_iteration_limit(int iterations);
+    void set_thread_count(int thread_count);
+    // Makes a move and returns the number of iterations (playouts) it took,
+    // which are not the nodes minimax counts. Returns -1 and leaves the
+    // board as it is if the game is over or the player has no legal move.
+    int make_next_move(board& board);
+
+private:
+    enum node_state : std::uint8_t {
+        LEAF,
+        EXPANDING,
+        EXPANDED,
+    };
+
+    // Children of a node are consecutive in the arena. The score is
+    // counted in half points for the player who made the node's move:
+    // 2 for a win, 1 for a draw.
+    struct node {
+        std::atomic<std::uint32_t> visits;
+        std::atomic<std::uint32_t> score;
+        std::atomic<node_state> state;
+        std::uint8_t x1, y1, x2, y2;
+        std::uint16_t child_count;
+        std::uint32_t first_child;
+    };
+
+    // State of one search thread
+    struct search_context {
+        std::mt19937_64 random;
+        std::vector<std::uint32_t> path;
+        std::vector<board::move> moves;
+        std::vector<board::move> playout_moves;
+    };
+
+    std::int64_t get_heuristic(const board& board) const;
+    void search(board& board, search_context& context);
+    bool expand(std::uint32_t index, const board& board, int player, search_context& context);
+    std::uint32_t select_child(const node& parent) const;
+    int playout(board& board, int player, int tree_depth, search_context& context);
+
+    int _player;
+    int _heuristic;
+    std::chrono::milliseconds _time_limit;
+    int _iteration_limit;
+    int _thread_count;
+
+    std::unique_ptr<node[]> _nodes;
+    std::atomic<std::uint32_t> _node_count;
+    std::atomic<bool> _tree_full;
+
+    std::chrono::steady_clock::time_point _deadline;
+    std::atomic<int> _iterations;
+    std::int64_t _root_score;
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+
+// Distance metrics the heuristics are built from. Every metric is a policy
+// with a constexpr distance, its per-cell tables are generated at compile
+// time so that updating a heuristic is a table lookup.
+
+struct manhattan_metric {
+    static constexpr std::int64_t distance(int dx, int dy)
+    {
+        return (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+    }
+};
+
+// Euclidean distance times 1000, rounded to the nearest integer
+struct euclidean_metric {
+    static constexpr std::int64_t distance(int dx, int dy)
+    {
+        std::uint64_t scaled = 1'000'000ULL * (dx * dx + dy * dy);
+
+        std::uint64_t root = 0;
+        for (std::uint64_t bit = 1ULL << 31; bit; bit >>= 1) {
+            if ((root | bit) * (root | bit) <= scaled) {
+                root |= bit;
+            }
+        }
+
+        // Round up when root + 0.5 is still below the exact square root
+        return static_cast<std::int64_t>((2 * root + 1) * (2 * root + 1) <= 4 * scaled ? root + 1 : root);
+    }
+};
+
+struct chebyshev_metric {
+    static constexpr std::int64_t distance(int dx, int dy)
+    {
+        dx = dx < 0 ? -dx : dx;
+        dy = dy < 0 ? -dy : dy;
+        return dx > dy ? dx : dy;
+    }
+};
+
+enum class metric_kind {
+    MANHATTAN,
+    EUCLIDEAN,
+    CHEBYSHEV,
+};
+
+// Distance of every cell of a board from the first (0, 0) and the last corner
+template <int Size>
+struct distance_tables {
+    std::int64_t first_corner[Size][Size];
+    std::int64_t last_corner[Size][Size];
+};
+
+template <int Size, typename Metric>
+constexpr distance_tables<Size> make_distance_tables()
+{
+    distance_tables<Size> tables{};
+
+    for (int x = 0; x < Size; ++x) {
+        for (int y = 0; y < Size; ++y) {
+            tables.first_corner[x][y] = Metric::distance(x, y);
+            tables.last_corner[x][y] = Metric::distance(Size - 1 - x, Size - 1 - y);
+        }
+    }
+
+    return tables;
+}
+
+template <int Size, typename Metric>
+inline constexpr distance_tables<Size> metric_tables = make_distance_tables<Size, Metric>();
+
+template <int Size>
+inline const distance_tables<Size>& get_distance_tables(metric_kind kind)
+{
+    switch (kind) {
+    case metric_kind::EUCLIDEAN: return metric_tables<Size, euclidean_metric>;
+    case metric_kind::CHEBYSHEV: return metric_tables<Size, chebyshev_metric>;
+    default: return metric_tables<Size, manhattan_metric>;
+    }
+}
+
+// Tables tuned offline are stored as text: the board size and then the
+// distance of every cell from the first corner, rows of y with x as
+// columns like in.txt. Distances from the last corner are the same table
+// turned around, as for every metric.
+template <int Size>
+bool read_distance_tables(std::istream& in, distance_tables<Size>& out)
+{
+    int size = 0;
+    if (!(in >> size) || size != Size) {
+        return false;
+    }
+
+    for (int y = 0; y < Size; ++y) {
+        for (int x = 0; x < Size; ++x) {
+            if (!(in >> out.first_corner[x][y])) {
+                return false;
+            }
+        }
+    }
+
+    for (int x = 0; x < Size; ++x) {
+        for (int y = 0; y < Size; ++y) {
+            out.last_corner[x][y] = out.first_corner[Size - 1 - x][Size - 1 - y];
+        }
+    }
+
+    return true;
+}
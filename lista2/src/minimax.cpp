@@ -1,36 +1,242 @@
 #include "minimax.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <random>
+#include <sstream>
+#include <thread>
+#include <utility>
 
-minimax::minimax(int which_player, int which_heuristic)
+// 2^20 entries, 24 MB per player
+static constexpr int TRANSPOSITION_TABLE_BITS = 20;
+
+// How many nodes are visited between two looks at the clock and the abort flag
+static constexpr int TIME_CHECK_INTERVAL = 1024;
+
+// Scores beyond this are wins or losses, no aspiration window is put around them
+static constexpr std::int64_t ASPIRATION_LIMIT = LLONG_MAX / 4;
+
+static inline bool same_move(const board_move& first, const board_move& second)
+{
+    return first.x1 == second.x1 && first.y1 == second.y1
+        && first.x2 == second.x2 && first.y2 == second.y2;
+}
+
+static inline int history_index(const board_move& move)
+{
+    return ((move.x1 * FRAME_SIZE + move.y1) * FRAME_SIZE + move.x2) * FRAME_SIZE + move.y2;
+}
+
+template <typename Layout>
+basic_minimax<Layout>::basic_minimax(int which_player, int which_heuristic)
     : _player(which_player)
     , _heuristic(which_heuristic)
     , _depth(4)
+    , _time_limit(0)
+    , _thread_count(1)
+    , _profiling(false)
+    , _table(TRANSPOSITION_TABLE_BITS)
+    , _table_stats{}
+    , _search_stats{}
+    , _contexts{}
+    , _pondering(false)
+    , _ponder_stop(false)
+    , _ponder_position(0)
+    , _ponder_context{}
+    , _ponder_stats{}
+    , _book_stats{}
+{
+}
+
+template <typename Layout>
+basic_minimax<Layout>::~basic_minimax()
 {
+    if (_ponder_thread.joinable()) {
+        _ponder_stop = true;
+        _ponder_thread.join();
+    }
 }
 
-void minimax::set_depth(int depth)
+template <typename Layout>
+void basic_minimax<Layout>::set_depth(int depth)
 {
     _depth = depth;
 }
 
-int minimax::make_next_move(board& board)
+template <typename Layout>
+void basic_minimax<Layout>::set_time_limit(std::chrono::milliseconds limit)
+{
+    _time_limit = limit;
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::set_thread_count(int thread_count)
 {
+    assert(thread_count >= 1);
+    _thread_count = thread_count;
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::set_profiling(bool enabled)
+{
+    _profiling = enabled;
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::set_pondering(bool enabled)
+{
+    _pondering = enabled;
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::add_book(const position_book* book)
+{
+    _books.push_back(book);
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::new_search()
+{
+    if (_ponder_thread.joinable()) {
+        _ponder_stop = true;
+        _ponder_thread.join();
+    }
+
+    _table.new_search();
+}
+
+template <typename Layout>
+auto basic_minimax<Layout>::get_table_stats() const -> const table_stats&
+{
+    return _table_stats;
+}
+
+template <typename Layout>
+auto basic_minimax<Layout>::get_search_stats() const -> const search_stats&
+{
+    return _search_stats;
+}
+
+template <typename Layout>
+auto basic_minimax<Layout>::get_ponder_stats() const -> const ponder_stats&
+{
+    return _ponder_stats;
+}
+
+template <typename Layout>
+auto basic_minimax<Layout>::get_book_stats() const -> const book_stats&
+{
+    return _book_stats;
+}
+
+template <typename Layout>
+double basic_minimax<Layout>::search_stats::effective_branching_factor() const
+{
+    if (iterations.empty() || iterations.back().nodes == 0) {
+        return 0.0;
+    }
+
+    // Growth of the tree from the previous iteration to the last one, or
+    // the depth-th root of its size if there was only one
+    const auto& last = iterations.back();
+    if (iterations.size() >= 2 && iterations[iterations.size() - 2].nodes > 0) {
+        return static_cast<double>(last.nodes) / iterations[iterations.size() - 2].nodes;
+    }
+
+    return std::pow(static_cast<double>(last.nodes), 1.0 / last.depth);
+}
+
+// One line of JSON, times are in milliseconds
+template <typename Layout>
+std::string basic_minimax<Layout>::search_stats::to_json() const
+{
+    auto ms = [](std::chrono::nanoseconds time) { return time.count() / 1e6; };
+
+    std::ostringstream out;
+    out << "{\"nodes\": " << nodes
+        << ", \"time_ms\": " << ms(time)
+        << ", \"movegen_ms\": " << ms(movegen_time)
+        << ", \"eval_ms\": " << ms(eval_time)
+        << ", \"effective_branching_factor\": " << effective_branching_factor()
+        << ", \"table\": {\"probes\": " << table.probes
+        << ", \"hits\": " << table.hits
+        << ", \"hit_rate\": " << (table.probes ? static_cast<double>(table.hits) / table.probes : 0.0)
+        << ", \"cutoffs\": " << table.cutoffs << "}";
+
+    out << ", \"iterations\": [";
+    for (std::size_t i = 0; i < iterations.size(); ++i) {
+        out << (i ? ", " : "") << "{\"depth\": " << iterations[i].depth
+            << ", \"nodes\": " << iterations[i].nodes
+            << ", \"time_ms\": " << ms(iterations[i].time)
+            << ", \"score\": " << iterations[i].score << "}";
+    }
+
+    out << "], \"plies\": [";
+    for (std::size_t i = 0; i < plies.size(); ++i) {
+        const auto& ply = plies[i];
+        out << (i ? ", " : "") << "{\"ply\": " << i
+            << ", \"nodes\": " << ply.nodes
+            << ", \"expanded\": " << ply.expanded
+            << ", \"cutoffs\": " << ply.cutoffs
+            << ", \"first_move_cutoff_rate\": "
+            << (ply.cutoffs ? static_cast<double>(ply.first_move_cutoffs) / ply.cutoffs : 0.0) << "}";
+    }
+
+    out << "]}";
+    return out.str();
+}
+
+template <typename Layout>
+int basic_minimax<Layout>::make_next_move(board& board)
+{
+    if (board.get_winner() || board.get_legal_moves(_player).empty()) {
+        stop_pondering(board);
+        return -1;
+    }
+
     int nodes = 0;
     auto move = get_best_move(board, nodes);
     board.move_piece(move);
 
+    if (_pondering && !board.get_winner()) {
+        start_pondering(board);
+    }
+
     return nodes;
 }
 
-std::int64_t minimax::get_heuristic(const board& board)
+// Searches the position like make_next_move, but leaves the move to the
+// caller and does not ponder. The player has to have a legal move.
+template <typename Layout>
+board_move basic_minimax<Layout>::find_next_move(board& board)
+{
+    int nodes = 0;
+    return get_best_move(board, nodes);
+}
+
+template <typename Layout>
+std::int64_t basic_minimax<Layout>::get_heuristic(const board& board)
 {
     assert(_heuristic == 1 || _heuristic == 2);
     assert(_player == 1 || _player == 2);
 
-    std::int64_t sign = _player == 1 ? 1 : -1;
-    return sign * (_heuristic == 1 ? board.get_heuristic_one() : board.get_heuristic_two());
+    return get_player_score(_heuristic == 1 ? board.get_heuristic_one() : board.get_heuristic_two());
+}
+
+// Turns a heuristic, which favours the first player, into a score for the
+// searching player
+template <typename Layout>
+std::int64_t basic_minimax<Layout>::get_player_score(std::int64_t score) const
+{
+    if (_player == 1) {
+        return score;
+    }
+
+    // A win of the second player is LLONG_MIN, which cannot be negated
+    return score == LLONG_MIN ? LLONG_MAX : -score;
 }
 
 static inline int next_player(int player)
@@ -38,70 +244,644 @@ static inline int next_player(int player)
     return player == 1 ? 2 : 1;
 }
 
-board::move minimax::get_best_move(board& board, int& nodes)
+// The buffers keep their capacity from the previous search, so an engine
+// reused for many searches does not allocate them again. Counters, killer
+// moves and history scores start over.
+template <typename Layout>
+void basic_minimax<Layout>::reset_context(search_context& context, const std::atomic<bool>* abort)
+{
+    context.deadline = std::chrono::steady_clock::now() + _time_limit;
+    context.abort = abort;
+    context.can_stop = false;
+    context.stopped = false;
+    context.profiling = _profiling;
+    context.nodes = 0;
+    context.next_check = 0;
+    context.stats = search_stats{};
+    context.stats.plies.assign(_depth + 1, ply_stats{});
+    context.killers.assign(_depth + 1, {});
+    context.history.assign(FRAME_SIZE * FRAME_SIZE * FRAME_SIZE * FRAME_SIZE, 0);
+    context.move_stack.resize((_depth + 1) * board::MAX_MOVES);
+    context.rank_stack.resize((_depth + 1) * board::MAX_MOVES);
+    context.leaf_scores.resize(board::MAX_MOVES);
+}
+
+template <typename Layout>
+board_move basic_minimax<Layout>::get_best_move(board& board, int& nodes)
+{
+    auto search_start = std::chrono::steady_clock::now();
+
+    bool ponder_hit = stop_pondering(board);
+
+    board_move book_move;
+    if (probe_books(board, book_move)) {
+        _search_stats = search_stats{};
+        _search_stats.time = std::chrono::steady_clock::now() - search_start;
+        _search_stats.plies.assign(_depth + 1, ply_stats{});
+        return book_move;
+    }
+
+    if (ponder_hit) {
+        nodes += _ponder_context.nodes;
+        collect_stats(&_ponder_context, 1, std::chrono::steady_clock::now() - search_start);
+        return pick_move(_ponder_moves);
+    }
+
+    _table.new_search();
+
+    // Lazy SMP: helper threads search the same position on their own board
+    // copies and only share the transposition table. Their results are
+    // thrown away, but the entries they store let the main thread skip
+    // whole subtrees. The main thread stops the helpers once it is done.
+    std::atomic<bool> finished = false;
+    std::vector<basic_board<Layout>> boards(_thread_count - 1, board);
+
+    _contexts.resize(_thread_count);
+    reset_context(_contexts[0], nullptr);
+    for (int i = 1; i < _thread_count; ++i) {
+        reset_context(_contexts[i], &finished);
+    }
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < _thread_count; ++i) {
+        helpers.emplace_back([&, i] { search_root(boards[i - 1], _contexts[i], i); });
+    }
+
+    auto best_moves = search_root(board, _contexts[0], 0);
+
+    finished = true;
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    for (int i = 0; i < _thread_count; ++i) {
+        nodes += _contexts[i].nodes;
+    }
+
+    collect_stats(_contexts.data(), _thread_count, std::chrono::steady_clock::now() - search_start);
+    return pick_move(best_moves);
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::collect_stats(const search_context* contexts, int count,
+    std::chrono::steady_clock::duration time)
+{
+    _search_stats = search_stats{};
+    _search_stats.time = time;
+    _search_stats.plies.assign(_depth + 1, ply_stats{});
+    _search_stats.iterations = contexts[0].stats.iterations;
+
+    for (int i = 0; i < count; ++i) {
+        const auto& context = contexts[i];
+        _search_stats.nodes += context.nodes;
+        _search_stats.movegen_time += context.stats.movegen_time;
+        _search_stats.eval_time += context.stats.eval_time;
+        _search_stats.table.probes += context.stats.table.probes;
+        _search_stats.table.hits += context.stats.table.hits;
+        _search_stats.table.cutoffs += context.stats.table.cutoffs;
+
+        for (int ply = 0; ply <= _depth; ++ply) {
+            _search_stats.plies[ply].nodes += context.stats.plies[ply].nodes;
+            _search_stats.plies[ply].expanded += context.stats.plies[ply].expanded;
+            _search_stats.plies[ply].cutoffs += context.stats.plies[ply].cutoffs;
+            _search_stats.plies[ply].first_move_cutoffs += context.stats.plies[ply].first_move_cutoffs;
+        }
+    }
+
+    _table_stats.probes += _search_stats.table.probes;
+    _table_stats.hits += _search_stats.table.hits;
+    _table_stats.cutoffs += _search_stats.table.cutoffs;
+}
+
+template <typename Layout>
+board_move basic_minimax<Layout>::pick_move(const std::vector<board_move>& best_moves)
+{
+    // One generator per thread, players of different games may search
+    // at the same time
+    static thread_local std::mt19937_64 mt(std::random_device{}());
+
+    assert(!best_moves.empty());
+    std::uniform_int_distribution<size_t> dist(0, best_moves.size() - 1);
+    return best_moves[dist(mt)];
+}
+
+template <typename Layout>
+bool basic_minimax<Layout>::probe_books(const board& board, board_move& out)
+{
+    if (_books.empty()) {
+        return false;
+    }
+
+    ++_book_stats.probes;
+    std::uint64_t key = board.hash_position(_player);
+
+    for (const auto* book : _books) {
+        const auto* found = book->probe(key);
+        if (!found) {
+            continue;
+        }
+
+        // Another position with the same key, or a book of another board,
+        // must not make an illegal move
+        board_move move{ .x1 = found->x1, .y1 = found->y1, .x2 = found->x2, .y2 = found->y2 };
+        auto moves = board.get_legal_moves(_player);
+        if (std::any_of(moves.begin(), moves.end(),
+            [&](const board_move& legal) { return same_move(legal, move); })) {
+            ++_book_stats.hits;
+            out = move;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::start_pondering(const board& board)
+{
+    // The predicted reply is the best move stored for the position after
+    // our move, which the search just left in the table
+    int opponent = next_player(_player);
+    auto stored = _table.probe(board.hash_position(opponent));
+    if (!stored || !stored->has_move) {
+        return;
+    }
+
+    auto replies = board.get_legal_moves(opponent);
+    if (std::none_of(replies.begin(), replies.end(),
+        [&](const board_move& reply) { return same_move(reply, stored->best_move); })) {
+        return;
+    }
+
+    basic_board<Layout> predicted = board;
+    predicted.move_piece(stored->best_move);
+    if (predicted.get_winner()) {
+        return;
+    }
+
+    ++_ponder_stats.predictions;
+    _table.new_search();
+    _ponder_stop = false;
+    _ponder_position = predicted.hash_position();
+
+    // Pondering ignores the time limit, it runs until the opponent moves
+    reset_context(_ponder_context, &_ponder_stop);
+    _ponder_context.deadline = std::chrono::steady_clock::time_point::max();
+    _ponder_context.can_stop = true;
+
+    _ponder_thread = std::thread([this, predicted]() mutable {
+        _ponder_moves = search_root(predicted, _ponder_context, 0);
+        });
+}
+
+template <typename Layout>
+bool basic_minimax<Layout>::stop_pondering(const board& board)
+{
+    if (!_ponder_thread.joinable()) {
+        return false;
+    }
+
+    // Without a time limit a correctly predicted search is simply finished,
+    // otherwise it is aborted and the next search starts from its table
+    // entries. Returns whether the pondered search is the one to play.
+    bool hit = board.hash_position() == _ponder_position;
+    if (!hit || _time_limit.count() > 0) {
+        _ponder_stop = true;
+    }
+
+    _ponder_thread.join();
+
+    if (hit) {
+        ++_ponder_stats.hits;
+    }
+
+    return hit && !_ponder_context.stopped;
+}
+
+template <typename Layout>
+std::vector<board_move> basic_minimax<Layout>::search_root(board& board, search_context& context, int thread_index)
 {
     auto moves = board.get_legal_moves(_player);
+    std::vector<std::int64_t> scores(moves.size());
+    std::vector<board_move> best_moves;
+
+    // Helpers start on different root moves and every other one skips the
+    // first iteration, so that threads do not walk the same tree in lockstep
+    int first_depth = 1;
+    if (thread_index > 0) {
+        std::rotate(moves.begin(), moves.begin() + thread_index * moves.size() / _thread_count, moves.end());
+        first_depth = std::min(_depth, 1 + thread_index % 2);
+        context.can_stop = true;
+    }
+
+    // Every iteration searches one ply deeper, starting with the best moves
+    // of the previous one. When time runs out in the middle of an iteration,
+    // the moves of the last complete one are played.
+    std::vector<std::int64_t> iteration_scores;
+    for (int depth = first_depth; depth <= _depth; ++depth) {
+        std::vector<board_move> iteration_best_moves;
+        auto iteration_start = std::chrono::steady_clock::now();
+        int iteration_start_nodes = context.nodes;
+
+        // Aspiration window: the score usually stays close to the last one,
+        // and swings between iterations about as much as it did before.
+        // If the result falls outside, that side is opened and searched again.
+        std::int64_t alpha = LLONG_MIN;
+        std::int64_t beta = LLONG_MAX;
+        if (iteration_scores.size() >= 2) {
+            std::int64_t last = iteration_scores.back();
+            std::int64_t before = iteration_scores[iteration_scores.size() - 2];
+
+            if (std::abs(last) < ASPIRATION_LIMIT && std::abs(before) < ASPIRATION_LIMIT) {
+                std::int64_t delta = std::abs(last - before) + 1;
+                alpha = last - delta;
+                beta = last + delta;
+            }
+        }
+
+        std::int64_t best_move_score;
+        while (true) {
+            ++context.stats.plies[0].nodes;
+            ++context.stats.plies[0].expanded;
+
+            best_move_score = search_root_moves(board, context, moves, scores,
+                depth, alpha, beta, iteration_best_moves);
+
+            if (context.stopped) break;
+            else if (best_move_score <= alpha && alpha != LLONG_MIN) alpha = LLONG_MIN;
+            else if (best_move_score >= beta && beta != LLONG_MAX) beta = LLONG_MAX;
+            else break;
+        }
+
+        if (context.stopped) {
+            break;
+        }
+
+        best_moves = iteration_best_moves;
+        iteration_scores.push_back(best_move_score);
+        context.stats.iterations.push_back(iteration_stats{
+            .depth = depth,
+            .nodes = static_cast<std::uint64_t>(context.nodes - iteration_start_nodes),
+            .time = std::chrono::steady_clock::now() - iteration_start,
+            .score = best_move_score,
+            });
+        context.can_stop = context.can_stop || _time_limit.count() > 0;
+
+        std::vector<int> order(moves.size());
+        for (int i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+
+        std::stable_sort(order.begin(), order.end(),
+            [&](int first, int second) { return scores[first] > scores[second]; });
+
+        std::vector<board_move> sorted_moves;
+        for (int i : order) {
+            sorted_moves.push_back(moves[i]);
+        }
+        moves = sorted_moves;
+    }
+
+    return best_moves;
+}
+
+template <typename Layout>
+std::int64_t basic_minimax<Layout>::search_root_moves(board& board, search_context& context,
+    const std::vector<board_move>& moves, std::vector<std::int64_t>& scores,
+    int depth, std::int64_t alpha, std::int64_t beta, std::vector<board_move>& best_moves)
+{
     std::int64_t best_move_score = LLONG_MIN;
-    std::vector<board::move> best_moves;
+    best_moves.clear();
 
-    for (auto& move : moves) {
- 
-        board.move_piece(move);
-        auto score = alphabeta_rec(board, nodes, _player, _depth - 1, LLONG_MIN, LLONG_MAX);
+    for (int i = 0; i < moves.size() && !context.stopped; ++i) {
+        board.move_piece(moves[i]);
+        if (i == 0) {
+            scores[i] = alphabeta_rec(board, context, next_player(_player), 1, depth - 1, alpha, beta);
+        }
+        else {
+            scores[i] = alphabeta_rec(board, context, next_player(_player), 1, depth - 1, alpha, alpha + 1);
+            if (scores[i] > alpha && scores[i] < beta) {
+                scores[i] = alphabeta_rec(board, context, next_player(_player), 1, depth - 1, alpha, beta);
+            }
+        }
+        board.undo_move(moves[i]);
 
-        if (best_move_score == LLONG_MIN || score > best_move_score) {
+        if (best_moves.empty() || scores[i] > best_move_score) {
             best_moves.clear();
-            best_moves.emplace_back(move);
-            best_move_score = score;
+            best_moves.emplace_back(moves[i]);
+            best_move_score = scores[i];
         }
-        else if (score == best_move_score) {
-            best_moves.emplace_back(move);
+        else if (scores[i] == best_move_score) {
+            best_moves.emplace_back(moves[i]);
         }
 
-        board.undo_move(move);
+        if (best_move_score >= beta) {
+            break;
+        }
+
+        // All moves as good as the best one are kept, so the bound stays
+        // just below its score: ties still come back exact, worse moves
+        // only as an upper bound
+        if (best_move_score > LLONG_MIN) {
+            alpha = std::max(alpha, best_move_score - 1);
+        }
     }
 
-    static std::random_device rd;
-    static std::mt19937_64 mt(rd());
+    return best_move_score;
+}
 
-    std::uniform_int_distribution<size_t> dist(0, best_moves.size() - 1);
-    return best_moves[dist(mt)];
+template <typename Layout>
+bool basic_minimax<Layout>::should_stop(search_context& context)
+{
+    // Nodes one ply above the leaves count all their children at once, so
+    // the clock is read once the count passes the next check
+    if (!context.stopped && context.can_stop && context.nodes >= context.next_check) {
+        context.next_check = context.nodes + TIME_CHECK_INTERVAL;
+        context.stopped = (context.abort && context.abort->load(std::memory_order_relaxed))
+            || (_time_limit.count() > 0 && std::chrono::steady_clock::now() >= context.deadline);
+    }
+
+    return context.stopped;
 }
 
-std::int64_t minimax::alphabeta_rec(board& board, int& nodes, int player, int depth_left,
-    std::int64_t alpha, std::int64_t beta)
+template <typename Layout>
+void basic_minimax<Layout>::rank_moves(const board_move* moves, int move_count, const search_context& context,
+    int ply, const board_move* table_move, std::int64_t* ranks)
 {
-    ++nodes; // Increase visited nodes counter
+    // Best move from the table first, then killer moves of this ply, then
+    // moves that caused cutoffs most often anywhere in the tree
+    for (int i = 0; i < move_count; ++i) {
+        auto& move = moves[i];
+
+        if (table_move && same_move(move, *table_move)) ranks[i] = LLONG_MAX;
+        else if (same_move(move, context.killers[ply][0])) ranks[i] = LLONG_MAX - 1;
+        else if (same_move(move, context.killers[ply][1])) ranks[i] = LLONG_MAX - 2;
+        else ranks[i] = context.history[history_index(move)];
+    }
+}
+
+static void pick_next_move(board_move* moves, std::int64_t* ranks, int move_count, int index)
+{
+    // Most nodes are cut off after a few moves, so instead of sorting all
+    // of them the best remaining one is moved forward when it is needed
+    int best = index;
+    for (int i = index + 1; i < move_count; ++i) {
+        if (ranks[i] > ranks[best]) {
+            best = i;
+        }
+    }
+
+    std::swap(moves[index], moves[best]);
+    std::swap(ranks[index], ranks[best]);
+}
+
+template <typename Layout>
+void basic_minimax<Layout>::record_cutoff(search_context& context, int ply, int depth_left,
+    const board_move& move, bool first_move)
+{
+    ++context.stats.plies[ply].cutoffs;
+    if (first_move) {
+        ++context.stats.plies[ply].first_move_cutoffs;
+    }
+
+    auto& killers = context.killers[ply];
+    if (!same_move(move, killers[0])) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+
+    context.history[history_index(move)] += depth_left * depth_left;
+}
+
+// One ply above the leaves all children are scored in one batch. The best
+// of them decides the node: a cutoff if it reaches the other bound, the
+// exact score if it falls within the window and a bound if all fall
+// short. So the node takes one pass over the scores instead of making and
+// evaluating its moves in order.
+template <typename Layout>
+std::int64_t basic_minimax<Layout>::search_frontier(board& board, search_context& context, int player, int ply,
+    std::uint64_t key, const board_move* moves, int move_count, std::int64_t alpha, std::int64_t beta)
+{
+    std::int64_t* scores = context.leaf_scores.data();
+
+    auto eval_start = context.profiling ? std::chrono::steady_clock::now()
+        : std::chrono::steady_clock::time_point{};
+    board.evaluate_moves(player, _heuristic, moves, move_count, scores);
+    if (context.profiling) {
+        context.stats.eval_time += std::chrono::steady_clock::now() - eval_start;
+    }
+
+    context.nodes += move_count;
+    context.stats.plies[ply + 1].nodes += move_count;
+
+    bool our_move = player == _player;
+    int best = -1;
+    std::int64_t best_score = 0;
+    for (int i = 0; i < move_count; ++i) {
+        std::int64_t score = get_player_score(scores[i]);
+        if (best < 0 || (our_move ? score > best_score : score < best_score)) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    std::int64_t original_alpha = alpha;
+    std::int64_t original_beta = beta;
+    const board_move* best_move = nullptr;
+
+    if (best >= 0 && our_move && best_score > alpha) {
+        alpha = best_score;
+        best_move = &moves[best];
+    }
+    else if (best >= 0 && !our_move && best_score < beta) {
+        beta = best_score;
+        best_move = &moves[best];
+    }
+
+    // The batch has no move order, so its cutoffs do not count as first
+    // move cutoffs
+    if (alpha >= beta) {
+        record_cutoff(context, ply, 1, moves[best], false);
+    }
+
+    auto bound = transposition_table::EXACT;
+    if (our_move) {
+        bound = alpha >= beta ? transposition_table::LOWER_BOUND
+            : alpha <= original_alpha ? transposition_table::UPPER_BOUND
+            : transposition_table::EXACT;
+    }
+    else {
+        bound = beta <= alpha ? transposition_table::UPPER_BOUND
+            : beta >= original_beta ? transposition_table::LOWER_BOUND
+            : transposition_table::EXACT;
+    }
+
+    _table.store(key, transposition_table::entry{
+        .depth = 1,
+        .bound = bound,
+        .score = our_move ? alpha : beta,
+        .has_move = best_move != nullptr,
+        .best_move = best_move ? *best_move : board_move{},
+        });
+
+    return our_move ? alpha : beta;
+}
+
+template <typename Layout>
+std::int64_t basic_minimax<Layout>::alphabeta_rec(board& board, search_context& context, int player,
+    int ply, int depth_left, std::int64_t alpha, std::int64_t beta)
+{
+    ++context.nodes; // Increase visited nodes counter
+    ++context.stats.plies[ply].nodes;
+
+    if (should_stop(context)) {
+        return 0;
+    }
 
     if (depth_left <= 0 || board.get_winner()) {
-        return get_heuristic(board);
+        if (!context.profiling) {
+            return get_heuristic(board);
+        }
+
+        auto eval_start = std::chrono::steady_clock::now();
+        std::int64_t score = get_heuristic(board);
+        context.stats.eval_time += std::chrono::steady_clock::now() - eval_start;
+        return score;
+    }
+
+    std::uint64_t key = board.hash_position(player);
+    auto stored = _table.probe(key);
+    ++context.stats.table.probes;
+
+    if (stored) {
+        ++context.stats.table.hits;
+
+        if (stored->depth >= depth_left
+            && (stored->bound == transposition_table::EXACT
+                || (stored->bound == transposition_table::LOWER_BOUND && stored->score >= beta)
+                || (stored->bound == transposition_table::UPPER_BOUND && stored->score <= alpha))) {
+            ++context.stats.table.cutoffs;
+            return stored->score;
+        }
+    }
+
+    // The table move is only trusted if it is generated here too, since
+    // different positions may share a slot
+    board_move* moves = &context.move_stack[ply * board::MAX_MOVES];
+    std::int64_t* ranks = &context.rank_stack[ply * board::MAX_MOVES];
+    auto movegen_start = context.profiling ? std::chrono::steady_clock::now()
+        : std::chrono::steady_clock::time_point{};
+    int move_count = board.get_legal_moves(player, moves);
+    if (context.profiling) {
+        context.stats.movegen_time += std::chrono::steady_clock::now() - movegen_start;
     }
 
-    auto moves = board.get_legal_moves(player);
-    if (player != _player) { // If that's our move
-        for (auto& move : moves) {
+    ++context.stats.plies[ply].expanded;
+    if (depth_left == 1) {
+        return search_frontier(board, context, player, ply, key, moves, move_count, alpha, beta);
+    }
+
+    rank_moves(moves, move_count, context, ply,
+        stored && stored->has_move ? &stored->best_move : nullptr, ranks);
+
+    std::int64_t original_alpha = alpha;
+    std::int64_t original_beta = beta;
+    const board_move* best_move = nullptr;
+
+    if (player != _player) { // If that's our opponent's move
+        for (int i = 0; i < move_count; ++i) {
+            pick_next_move(moves, ranks, move_count, i);
+            auto& move = moves[i];
+
+            // Principal variation search: after the first move, the others
+            // only have to be shown worse, which a null window does cheaply
             board.move_piece(move);
-            beta = std::min(beta, alphabeta_rec(board, nodes,
-                next_player(player), depth_left - 1, alpha, beta));
+            std::int64_t score;
+            if (i == 0) {
+                score = alphabeta_rec(board, context, next_player(player), ply + 1, depth_left - 1, alpha, beta);
+            }
+            else {
+                score = alphabeta_rec(board, context, next_player(player), ply + 1, depth_left - 1, beta - 1, beta);
+                if (score < beta && score > alpha) {
+                    score = alphabeta_rec(board, context, next_player(player), ply + 1, depth_left - 1, alpha, beta);
+                }
+            }
             board.undo_move(move);
+
+            if (score < beta) {
+                beta = score;
+                best_move = &move;
+            }
+
             if (alpha >= beta) {
+                record_cutoff(context, ply, depth_left, move, i == 0);
                 break;
             }
         }
 
+        if (context.stopped) {
+            return 0;
+        }
+
+        _table.store(key, transposition_table::entry{
+            .depth = depth_left,
+            .bound = beta <= alpha ? transposition_table::UPPER_BOUND
+                : beta >= original_beta ? transposition_table::LOWER_BOUND
+                : transposition_table::EXACT,
+            .score = beta,
+            .has_move = best_move != nullptr,
+            .best_move = best_move ? *best_move : board_move{},
+            });
+
         return beta;
     }
-    else { // If that's our opponent's move
-        for (auto& move : moves) {
+    else { // If that's our move
+        for (int i = 0; i < move_count; ++i) {
+            pick_next_move(moves, ranks, move_count, i);
+            auto& move = moves[i];
+
             board.move_piece(move);
-            alpha = std::max(alpha, alphabeta_rec(board, nodes,
-                next_player(player), depth_left - 1, alpha, beta));
+            std::int64_t score;
+            if (i == 0) {
+                score = alphabeta_rec(board, context, next_player(player), ply + 1, depth_left - 1, alpha, beta);
+            }
+            else {
+                score = alphabeta_rec(board, context, next_player(player), ply + 1, depth_left - 1, alpha, alpha + 1);
+                if (score > alpha && score < beta) {
+                    score = alphabeta_rec(board, context, next_player(player), ply + 1, depth_left - 1, alpha, beta);
+                }
+            }
             board.undo_move(move);
+
+            if (score > alpha) {
+                alpha = score;
+                best_move = &move;
+            }
+
             if (alpha >= beta) {
+                record_cutoff(context, ply, depth_left, move, i == 0);
                 break;
             }
         }
 
+        if (context.stopped) {
+            return 0;
+        }
+
+        _table.store(key, transposition_table::entry{
+            .depth = depth_left,
+            .bound = alpha >= beta ? transposition_table::LOWER_BOUND
+                : alpha <= original_alpha ? transposition_table::UPPER_BOUND
+                : transposition_table::EXACT,
+            .score = alpha,
+            .has_move = best_move != nullptr,
+            .best_move = best_move ? *best_move : board_move{},
+            });
+
         return alpha;
     }
 }
+
+template class basic_minimax<halma_16>;
+template class basic_minimax<halma_10>;
+template class basic_minimax<halma_8>;
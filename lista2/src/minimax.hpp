@@ -1,22 +1,174 @@
 #pragma once
 #include "board.hpp"
+#include "position_book.hpp"
+#include "transposition_table.hpp"
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
 
-class minimax {
+template <typename Layout>
+class basic_minimax {
 public:
-    minimax(int which_player, int which_heuristic);
+    using board = basic_board<Layout>;
+
+    struct table_stats {
+        std::uint64_t probes;
+        std::uint64_t hits;
+        std::uint64_t cutoffs;
+    };
+
+    struct ply_stats {
+        std::uint64_t nodes;
+        // Nodes whose moves were generated and searched
+        std::uint64_t expanded;
+        std::uint64_t cutoffs;
+        // Cutoffs caused by the first move searched. Frontier nodes score
+        // all moves in one batch and never count here.
+        std::uint64_t first_move_cutoffs;
+    };
+
+    struct iteration_stats {
+        int depth;
+        std::uint64_t nodes;
+        std::chrono::nanoseconds time;
+        // Score of the best move for the searching player
+        std::int64_t score;
+    };
+
+    // Statistics of one search, summed over all threads except for the
+    // iterations, which are those of the main thread. Move generation and
+    // evaluation are only timed with profiling on, since reading the clock
+    // at every node costs more than evaluating it.
+    struct search_stats {
+        std::uint64_t nodes;
+        std::chrono::nanoseconds time;
+        std::chrono::nanoseconds movegen_time;
+        std::chrono::nanoseconds eval_time;
+        table_stats table;
+        std::vector<ply_stats> plies;
+        std::vector<iteration_stats> iterations;
+
+        double effective_branching_factor() const;
+        std::string to_json() const;
+    };
+
+    struct ponder_stats {
+        std::uint64_t predictions;
+        std::uint64_t hits;
+    };
+
+    struct book_stats {
+        std::uint64_t probes;
+        std::uint64_t hits;
+    };
+
+    basic_minimax(int which_player, int which_heuristic);
+    ~basic_minimax();
 
     void set_depth(int depth);
+    void set_time_limit(std::chrono::milliseconds limit);
+    void set_thread_count(int thread_count);
+    void set_profiling(bool enabled);
+    void set_pondering(bool enabled);
+    void add_book(const position_book* book);
+    // Starts over for a new game with the same engine: a pondered search is
+    // stopped and thrown away and the table entries age, so that the new
+    // game replaces them first
+    void new_search();
+    // Makes a move and returns the number of nodes searched. Returns -1 and
+    // leaves the board as it is if the game is over or the player has no
+    // legal move.
     int make_next_move(board& board);
+    board_move find_next_move(board& board);
+    const table_stats& get_table_stats() const;
+    const search_stats& get_search_stats() const;
+    const ponder_stats& get_ponder_stats() const;
+    const book_stats& get_book_stats() const;
 
 private:
+    // State of one search thread: the deadline, killer moves of every ply,
+    // history scores of every (from, to) pair and counters. Helper threads
+    // also stop as soon as the main one sets the abort flag. Moves of every
+    // ply and their ranks live in buffers of board::MAX_MOVES entries per
+    // ply, kept by the engine from one search to the next.
+    struct search_context {
+        std::chrono::steady_clock::time_point deadline;
+        const std::atomic<bool>* abort;
+        bool can_stop;
+        bool stopped;
+        bool profiling;
+        int nodes;
+        // Node count at which the clock is read next
+        int next_check;
+        search_stats stats;
+        std::vector<std::array<board_move, 2>> killers;
+        std::vector<std::int32_t> history;
+        std::vector<board_move> move_stack;
+        std::vector<std::int64_t> rank_stack;
+        // Scores of the children of a node one ply above the leaves
+        std::vector<std::int64_t> leaf_scores;
+    };
+
     std::int64_t get_heuristic(const board& board);
-    board::move get_best_move(board& board, int& nodes);
-    std::int64_t alphabeta_rec(board& board, int& nodes, int player, int depth_left,
-        std::int64_t alpha, std::int64_t beta);
+    std::int64_t get_player_score(std::int64_t score) const;
+    board_move get_best_move(board& board, int& nodes);
+    void reset_context(search_context& context, const std::atomic<bool>* abort);
+    void collect_stats(const search_context* contexts, int count,
+        std::chrono::steady_clock::duration time);
+    board_move pick_move(const std::vector<board_move>& best_moves);
+    bool probe_books(const board& board, board_move& out);
+    void start_pondering(const board& board);
+    bool stop_pondering(const board& board);
+    std::vector<board_move> search_root(board& board, search_context& context, int thread_index);
+    std::int64_t search_root_moves(board& board, search_context& context,
+        const std::vector<board_move>& moves, std::vector<std::int64_t>& scores,
+        int depth, std::int64_t alpha, std::int64_t beta, std::vector<board_move>& best_moves);
+    bool should_stop(search_context& context);
+    void rank_moves(const board_move* moves, int move_count, const search_context& context,
+        int ply, const board_move* table_move, std::int64_t* ranks);
+    void record_cutoff(search_context& context, int ply, int depth_left,
+        const board_move& move, bool first_move);
+    std::int64_t search_frontier(board& board, search_context& context, int player, int ply,
+        std::uint64_t key, const board_move* moves, int move_count, std::int64_t alpha, std::int64_t beta);
+    std::int64_t alphabeta_rec(board& board, search_context& context, int player,
+        int ply, int depth_left, std::int64_t alpha, std::int64_t beta);
 
     int _player;
     int _heuristic;
     int _depth;
+    std::chrono::milliseconds _time_limit;
+    int _thread_count;
+    bool _profiling;
+
+    transposition_table _table;
+    table_stats _table_stats;
+    search_stats _search_stats;
+    // One context per search thread, the main one first
+    std::vector<search_context> _contexts;
+
+    // While the opponent thinks, a background thread searches the position
+    // after its predicted reply, filling the table for the next search
+    bool _pondering;
+    std::thread _ponder_thread;
+    std::atomic<bool> _ponder_stop;
+    std::uint64_t _ponder_position;
+    search_context _ponder_context;
+    std::vector<board_move> _ponder_moves;
+    ponder_stats _ponder_stats;
+
+    // Books are probed in the order they were added, before every search
+    std::vector<const position_book*> _books;
+    book_stats _book_stats;
 };
+
+// Every size we play is compiled once, in minimax.cpp
+extern template class basic_minimax<halma_16>;
+extern template class basic_minimax<halma_10>;
+extern template class basic_minimax<halma_8>;
+
+using minimax = basic_minimax<halma_16>;
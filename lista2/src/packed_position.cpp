@@ -0,0 +1,86 @@
+#include "packed_position.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+static constexpr char TRAINING_MAGIC[8] = { 'H', 'A', 'L', 'M', 'A', 'T', 'R', '1' };
+
+packed_position packed_position::pack(const board& board, int player)
+{
+    packed_position out{};
+    out.player = static_cast<std::uint8_t>(player);
+
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            out.set_cell(y * board::SIZE + x, board.get_piece(x, y));
+        }
+    }
+
+    return out;
+}
+
+int packed_position::get_cell(int index) const
+{
+    return (cells[index / 4] >> (index % 4 * 2)) & 3;
+}
+
+void packed_position::set_cell(int index, int piece)
+{
+    int shift = index % 4 * 2;
+    cells[index / 4] = static_cast<std::uint8_t>((cells[index / 4] & ~(3 << shift)) | (piece << shift));
+}
+
+// Every cell is set, so a board can be reused for many positions
+void packed_position::unpack(board& out) const
+{
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            out.set_piece(x, y, get_cell(y * board::SIZE + x));
+        }
+    }
+}
+
+bool write_training_positions(const char* path, const std::vector<training_position>& positions)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(TRAINING_MAGIC, sizeof(TRAINING_MAGIC));
+    out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(training_position));
+    return static_cast<bool>(out);
+}
+
+bool read_training_positions(const char* path, std::vector<training_position>& positions)
+{
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return false;
+    }
+
+    std::string data(std::istreambuf_iterator<char>(input), {});
+    std::size_t size = data.size() - sizeof(TRAINING_MAGIC);
+    if (data.size() < sizeof(TRAINING_MAGIC)
+        || std::memcmp(data.data(), TRAINING_MAGIC, sizeof(TRAINING_MAGIC)) != 0
+        || size % sizeof(training_position) != 0) {
+        return false;
+    }
+
+    positions.resize(size / sizeof(training_position));
+    std::memcpy(positions.data(), data.data() + sizeof(TRAINING_MAGIC), size);
+
+    // Any other player or result, or a cell of value 3, means the file is
+    // damaged
+    for (const auto& sample : positions) {
+        if ((sample.position.player != 1 && sample.position.player != 2) || sample.result > 2) {
+            return false;
+        }
+
+        for (int cell = 0; cell < board::SIZE * board::SIZE; ++cell) {
+            if (sample.position.get_cell(cell) == 3) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "board.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// A position of the 16x16 game in 65 bytes: the player to move and 2 bits
+// per cell, cell (x, y) at index y * SIZE + x as in in.txt. Tools keep
+// large sets of positions packed and unpack one at a time.
+struct packed_position {
+    std::uint8_t player;
+    std::uint8_t cells[board::SIZE * board::SIZE / 4];
+
+    static packed_position pack(const board& board, int player);
+    int get_cell(int index) const;
+    void set_cell(int index, int piece);
+    void unpack(board& out) const;
+};
+
+// A position of a self-play game and how the game ended for the first
+// player: 0 for a loss, 1 for a draw and 2 for a win
+struct training_position {
+    packed_position position;
+    std::uint8_t result;
+};
+
+static_assert(sizeof(packed_position) == 1 + board::SIZE * board::SIZE / 4);
+static_assert(sizeof(training_position) == sizeof(packed_position) + 1);
+
+// Files of training positions start with "HALMATR1", then the records
+bool write_training_positions(const char* path, const std::vector<training_position>& positions);
+bool read_training_positions(const char* path, std::vector<training_position>& positions);
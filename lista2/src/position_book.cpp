@@ -0,0 +1,186 @@
+#include "position_book.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Entries are mapped as they are, so the file is only readable on
+// machines with the byte order it was written on
+static_assert(std::endian::native == std::endian::little);
+static_assert(sizeof(position_book::entry) == 16);
+
+static constexpr char MAGIC[8] = { 'H', 'A', 'L', 'M', 'A', 'B', 'K', '1' };
+
+struct file_header {
+    char magic[8];
+    std::uint64_t entry_count;
+};
+
+position_book::position_book()
+    : _mapping(nullptr)
+    , _mapping_size(0)
+    , _entries(nullptr)
+    , _entry_count(0)
+{
+}
+
+position_book::~position_book()
+{
+    close();
+}
+
+static void* map_file(const char* path, std::size_t& size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < static_cast<LONGLONG>(sizeof(file_header))) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    // The view keeps the mapping and the file open after their handles
+    // are closed
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    size = static_cast<std::size_t>(file_size.QuadPart);
+    return data;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(file_header))) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    size = static_cast<std::size_t>(info.st_size);
+    return data;
+#endif
+}
+
+static void unmap_file(void* data, std::size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+bool position_book::open(const char* path)
+{
+    close();
+
+    std::size_t size = 0;
+    void* data = map_file(path, size);
+    if (!data) {
+        return false;
+    }
+
+    // A file of another format or cut short is rejected as a whole
+    const auto* header = static_cast<const file_header*>(data);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+        || header->entry_count != (size - sizeof(file_header)) / sizeof(entry)
+        || (size - sizeof(file_header)) % sizeof(entry) != 0) {
+        unmap_file(data, size);
+        return false;
+    }
+
+    _mapping = data;
+    _mapping_size = size;
+    _entries = reinterpret_cast<const entry*>(static_cast<const char*>(data) + sizeof(file_header));
+    _entry_count = static_cast<std::size_t>(header->entry_count);
+    return true;
+}
+
+void position_book::close()
+{
+    if (_mapping) {
+        unmap_file(_mapping, _mapping_size);
+    }
+
+    _mapping = nullptr;
+    _mapping_size = 0;
+    _entries = nullptr;
+    _entry_count = 0;
+}
+
+bool position_book::is_open() const
+{
+    return _mapping != nullptr;
+}
+
+std::size_t position_book::size() const
+{
+    return _entry_count;
+}
+
+auto position_book::probe(std::uint64_t key) const -> const entry*
+{
+    const entry* end = _entries + _entry_count;
+    const entry* found = std::lower_bound(_entries, end, key,
+        [](const entry& value, std::uint64_t key) { return value.key < key; });
+
+    return found != end && found->key == key ? found : nullptr;
+}
+
+bool position_book::write(const char* path, std::vector<entry> entries)
+{
+    // Sorted by key and then deepest first, so the first entry of every
+    // key is the one to keep
+    std::sort(entries.begin(), entries.end(), [](const entry& first, const entry& second) {
+        return first.key != second.key ? first.key < second.key : first.depth > second.depth;
+        });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+        [](const entry& first, const entry& second) { return first.key == second.key; }),
+        entries.end());
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    file_header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.entry_count = entries.size();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(entry));
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "board.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Moves of positions searched offline, like the opening book and the
+// endgame table, stored in a file sorted by the position hash with the
+// player to move. The file is memory-mapped, so opening it reads nothing
+// until a probe touches its pages and all processes share one copy.
+//
+// Layout, little-endian: the magic "HALMABK1", the entry count as
+// a 64-bit word and the entries.
+class position_book {
+public:
+    struct entry {
+        std::uint64_t key;
+        std::uint8_t x1, y1, x2, y2;
+        // Depth the move was searched to, the deepest one is kept when
+        // a position is written twice
+        std::uint8_t depth;
+        std::uint8_t reserved[3];
+    };
+
+    position_book();
+    ~position_book();
+    position_book(const position_book&) = delete;
+    position_book& operator=(const position_book&) = delete;
+
+    bool open(const char* path);
+    void close();
+    bool is_open() const;
+    std::size_t size() const;
+    const entry* probe(std::uint64_t key) const;
+
+    static bool write(const char* path, std::vector<entry> entries);
+
+private:
+    void* _mapping;
+    std::size_t _mapping_size;
+    const entry* _entries;
+    std::size_t _entry_count;
+};
@@ -0,0 +1,91 @@
+#include "transposition_table.hpp"
+
+// Layout of the data word, moves fit since coordinates are below 16
+static constexpr int MOVE_BITS = 16;
+static constexpr int DEPTH_SHIFT = MOVE_BITS;
+static constexpr int BOUND_SHIFT = DEPTH_SHIFT + 8;
+static constexpr int HAS_MOVE_SHIFT = BOUND_SHIFT + 2;
+static constexpr int GENERATION_SHIFT = HAS_MOVE_SHIFT + 1;
+
+static_assert(FRAME_SIZE <= 16);
+
+
+transposition_table::transposition_table(int size_bits)
+    : _slots(std::make_unique<slot[]>(1ULL << size_bits))
+    , _mask((1ULL << size_bits) - 1)
+    , _generation(0)
+{
+}
+
+void transposition_table::new_search()
+{
+    ++_generation;
+}
+
+std::uint64_t transposition_table::pack(const entry& value, std::uint8_t generation)
+{
+    std::uint64_t move = 0;
+    if (value.has_move) {
+        move = value.best_move.x1 | (value.best_move.y1 << 4)
+            | (value.best_move.x2 << 8) | (value.best_move.y2 << 12);
+    }
+
+    return move
+        | (static_cast<std::uint64_t>(value.depth & 0xFF) << DEPTH_SHIFT)
+        | (static_cast<std::uint64_t>(value.bound) << BOUND_SHIFT)
+        | (static_cast<std::uint64_t>(value.has_move) << HAS_MOVE_SHIFT)
+        | (static_cast<std::uint64_t>(generation) << GENERATION_SHIFT);
+}
+
+auto transposition_table::unpack(std::uint64_t score, std::uint64_t data) -> entry
+{
+    return entry{
+        .depth = static_cast<int>((data >> DEPTH_SHIFT) & 0xFF),
+        .bound = static_cast<bound_type>((data >> BOUND_SHIFT) & 3),
+        .score = static_cast<std::int64_t>(score),
+        .has_move = ((data >> HAS_MOVE_SHIFT) & 1) != 0,
+        .best_move = board::move{
+            .x1 = static_cast<int>(data & 15),
+            .y1 = static_cast<int>((data >> 4) & 15),
+            .x2 = static_cast<int>((data >> 8) & 15),
+            .y2 = static_cast<int>((data >> 12) & 15),
+            },
+    };
+}
+
+auto transposition_table::probe(std::uint64_t key) const -> std::optional<entry>
+{
+    const slot& target = _slots[key & _mask];
+
+    std::uint64_t check = target.check.load(std::memory_order_relaxed);
+    std::uint64_t score = target.score.load(std::memory_order_relaxed);
+    std::uint64_t data = target.data.load(std::memory_order_relaxed);
+
+    if ((check ^ score ^ data) != key || data == 0) {
+        return std::nullopt;
+    }
+
+    return unpack(score, data);
+}
+
+void transposition_table::store(std::uint64_t key, const entry& value)
+{
+    slot& target = _slots[key & _mask];
+
+    // Entries of an older search are always replaced, entries of the
+    // current one only by results of a search at least as deep
+    std::uint64_t old_data = target.data.load(std::memory_order_relaxed);
+    std::uint8_t old_generation = static_cast<std::uint8_t>(old_data >> GENERATION_SHIFT);
+    int old_depth = static_cast<int>((old_data >> DEPTH_SHIFT) & 0xFF);
+
+    if (old_data != 0 && old_generation == _generation && old_depth > value.depth) {
+        return;
+    }
+
+    std::uint64_t score = static_cast<std::uint64_t>(value.score);
+    std::uint64_t data = pack(value, _generation);
+
+    target.check.store(key ^ score ^ data, std::memory_order_relaxed);
+    target.score.store(score, std::memory_order_relaxed);
+    target.data.store(data, std::memory_order_relaxed);
+}
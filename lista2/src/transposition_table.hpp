@@ -0,0 +1,47 @@
+#pragma once
+#include "board.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+class transposition_table {
+public:
+    enum bound_type {
+        EXACT,
+        LOWER_BOUND,
+        UPPER_BOUND,
+    };
+
+    struct entry {
+        int depth;
+        bound_type bound;
+        std::int64_t score;
+        bool has_move;
+        board::move best_move;
+    };
+
+    explicit transposition_table(int size_bits);
+
+    void new_search();
+    std::optional<entry> probe(std::uint64_t key) const;
+    void store(std::uint64_t key, const entry& value);
+
+private:
+    // Every slot is three independent words and the first one holds the key
+    // XOR-ed with both data words. A slot torn by a concurrent writer does not
+    // pass the key check, so readers never need a lock.
+    struct slot {
+        std::atomic<std::uint64_t> check;
+        std::atomic<std::uint64_t> score;
+        std::atomic<std::uint64_t> data;
+    };
+
+    static std::uint64_t pack(const entry& value, std::uint8_t generation);
+    static entry unpack(std::uint64_t score, std::uint64_t data);
+
+    std::unique_ptr<slot[]> _slots;
+    std::uint64_t _mask;
+    std::uint8_t _generation;
+};
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "minimax.hpp"
+#include "packed_position.hpp"
+
+// Searches every position of a file on parallel worker threads and writes
+// the best move, its score for the player to move, the depth reached and
+// the node count of every position as CSV, one row per position in input
+// order. Finished positions get a row without a move.
+//
+// Positions are read as text, one per line: the player to move, a space
+// and board::SIZE^2 digits in the order of in.txt, rows of y with x as
+// columns. Empty lines and lines starting with # are skipped. A binary
+// file starts with "HALMAPS1" followed by packed positions, --convert
+// writes the positions read in that form. Positions stay packed until
+// a worker searches them, so that hundreds of thousands of them fit in
+// memory.
+//
+// Usage: analyse [--depth N] [--time-limit MS] [--workers N] [--metric NAME]
+//     [--output results.csv] [--convert positions.bin] POSITIONS
+
+static constexpr char MAGIC[8] = { 'H', 'A', 'L', 'M', 'A', 'P', 'S', '1' };
+
+struct analysis_options {
+    int depth = 3;
+    std::chrono::milliseconds time_limit{ 0 };
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    metric_kind metric = metric_kind::CHEBYSHEV;
+};
+
+struct analysis_result {
+    bool finished;
+    board::move move;
+    std::int64_t score;
+    int depth;
+    std::uint64_t nodes;
+    std::chrono::nanoseconds time;
+};
+
+static bool parse_metric(const std::string& name, metric_kind& out)
+{
+    if (name == "manhattan") out = metric_kind::MANHATTAN;
+    else if (name == "euclidean") out = metric_kind::EUCLIDEAN;
+    else if (name == "chebyshev") out = metric_kind::CHEBYSHEV;
+    else return false;
+
+    return true;
+}
+
+static bool read_binary(const std::string& data, std::vector<packed_position>& out)
+{
+    std::size_t size = data.size() - sizeof(MAGIC);
+    if (size % sizeof(packed_position) != 0) {
+        std::cerr << "Niepelny zapis pozycji w pliku binarnym" << std::endl;
+        return false;
+    }
+
+    out.resize(size / sizeof(packed_position));
+    std::memcpy(out.data(), data.data() + sizeof(MAGIC), size);
+
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        bool valid = out[i].player == 1 || out[i].player == 2;
+        for (int cell = 0; valid && cell < board::SIZE * board::SIZE; ++cell) {
+            valid = out[i].get_cell(cell) != 3;
+        }
+
+        if (!valid) {
+            std::cerr << "Bledna pozycja " << i << " w pliku binarnym" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool read_text(const std::string& data, std::vector<packed_position>& out)
+{
+    std::size_t line_start = 0;
+    int line_number = 0;
+
+    while (line_start < data.size()) {
+        std::size_t line_end = data.find('\n', line_start);
+        if (line_end == std::string::npos) {
+            line_end = data.size();
+        }
+
+        const char* line = data.data() + line_start;
+        std::size_t length = line_end - line_start;
+        if (length > 0 && line[length - 1] == '\r') {
+            --length;
+        }
+
+        ++line_number;
+        line_start = line_end + 1;
+
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+
+        packed_position position{};
+        bool valid = length == 2 + board::SIZE * board::SIZE
+            && (line[0] == '1' || line[0] == '2') && line[1] == ' ';
+
+        for (int cell = 0; valid && cell < board::SIZE * board::SIZE; ++cell) {
+            char piece = line[2 + cell];
+            valid = piece >= '0' && piece <= '2';
+            position.set_cell(cell, piece - '0');
+        }
+
+        if (!valid) {
+            std::cerr << "Bledna pozycja w linii " << line_number << std::endl;
+            return false;
+        }
+
+        position.player = static_cast<std::uint8_t>(line[0] - '0');
+        out.push_back(position);
+    }
+
+    return true;
+}
+
+static bool read_positions(const char* path, std::vector<packed_position>& out)
+{
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        std::cerr << "Nie mozna otworzyc pliku " << path << std::endl;
+        return false;
+    }
+
+    std::string data(std::istreambuf_iterator<char>(input), {});
+    if (data.size() >= sizeof(MAGIC) && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0) {
+        return read_binary(data, out);
+    }
+
+    return read_text(data, out);
+}
+
+static bool write_binary(const char* path, const std::vector<packed_position>& positions)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(packed_position));
+    return static_cast<bool>(out);
+}
+
+static analysis_result analyse_position(const packed_position& position, minimax& engine,
+    const analysis_options& options)
+{
+    board brd;
+    brd.set_metric_one(options.metric);
+    brd.set_metric_two(options.metric);
+
+    position.unpack(brd);
+
+    if (brd.get_winner() || brd.get_legal_moves(position.player).empty()) {
+        analysis_result result{};
+        result.finished = true;
+        return result;
+    }
+
+    auto move = engine.find_next_move(brd);
+    const auto& stats = engine.get_search_stats();
+
+    return analysis_result{
+        .finished = false,
+        .move = move,
+        .score = stats.iterations.empty() ? 0 : stats.iterations.back().score,
+        .depth = stats.iterations.empty() ? 0 : stats.iterations.back().depth,
+        .nodes = stats.nodes,
+        .time = stats.time,
+    };
+}
+
+static void write_csv(std::ostream& out, const std::vector<packed_position>& positions,
+    const std::vector<analysis_result>& results)
+{
+    out << "position,player,x1,y1,x2,y2,score,depth,nodes,time_ms\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        out << i << ',' << static_cast<int>(positions[i].player);
+
+        if (result.finished) {
+            out << ",,,,,,0,0,0\n";
+            continue;
+        }
+
+        out << ',' << result.move.x1 << ',' << result.move.y1
+            << ',' << result.move.x2 << ',' << result.move.y2
+            << ',' << result.score
+            << ',' << result.depth
+            << ',' << result.nodes
+            << ',' << result.time.count() / 1e6 << '\n';
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    analysis_options options;
+    const char* input_path = nullptr;
+    const char* output_path = nullptr;
+    const char* convert_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            options.depth = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+            options.time_limit = std::chrono::milliseconds(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            if (!parse_metric(argv[++i], options.metric)) {
+                std::cerr << "Nieznana metryka " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--convert") == 0 && i + 1 < argc) {
+            convert_path = argv[++i];
+        }
+        else {
+            input_path = argv[i];
+        }
+    }
+
+    if (!input_path) {
+        std::cerr << "Nie podano pliku z pozycjami" << std::endl;
+        return 1;
+    }
+
+    std::vector<packed_position> positions;
+    if (!read_positions(input_path, positions)) {
+        return 1;
+    }
+
+    if (convert_path) {
+        if (!write_binary(convert_path, positions)) {
+            std::cerr << "Nie mozna zapisac pliku " << convert_path << std::endl;
+            return 1;
+        }
+
+        std::cerr << "Zapisano " << positions.size() << " pozycji do " << convert_path << std::endl;
+        return 0;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // Every worker keeps one engine per player for all its positions, so
+    // their transposition tables are allocated once per run. Positions are
+    // taken by index and results stored in input order.
+    std::vector<analysis_result> results(positions.size());
+    std::atomic<std::size_t> next_position = 0;
+
+    auto worker = [&] {
+        minimax players[2] = { minimax(1, 1), minimax(2, 2) };
+        for (auto& player : players) {
+            player.set_depth(options.depth);
+            player.set_time_limit(options.time_limit);
+        }
+
+        for (std::size_t i = next_position++; i < positions.size(); i = next_position++) {
+            results[i] = analyse_position(positions[i], players[positions[i].player - 1], options);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.workers; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    auto duration = std::chrono::steady_clock::now() - start_time;
+    double seconds = std::chrono::duration<double>(duration).count();
+
+    if (output_path) {
+        std::ofstream out(output_path);
+        write_csv(out, positions, results);
+    }
+    else {
+        write_csv(std::cout, positions, results);
+    }
+
+    std::cerr << "Przeanalizowano " << positions.size() << " pozycji w "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        << " (" << (seconds > 0 ? positions.size() / seconds : 0.0) << " pozycji/s, watki: "
+        << options.workers << ")" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "board.hpp"
+#include "minimax.hpp"
+#include "position_book.hpp"
+
+// Builds the opening book and the endgame table minimax probes before it
+// searches. Games between two shallow minimax players sample the positions
+// that come up in play: the first plies of every game go to the opening
+// book, positions where the player to move has few pieces left outside its
+// target camp go to the endgame table. Every sampled position is then
+// searched to the book depth and its best move is written out. Positions
+// are sampled rather than enumerated, since with both armies on the board
+// even the endgames are too many to search them all.
+//
+// Usage: build_book [--games N] [--workers N] [--play-depth N] [--depth N]
+//     [--opening-plies N] [--outside N] [--random-plies N] [--max-plies N]
+//     [--metric NAME] [--seed N] [--input in.txt]
+//     [--opening opening.bin] [--endgame endgame.bin]
+
+struct book_options {
+    int games = 16;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    // Depth lista2 plays at, so that the sampled lines are the ones it plays
+    int play_depth = 3;
+    int depth = 4;
+    int opening_plies = 12;
+    int outside = 4;
+    int random_plies = 0;
+    int max_plies = 400;
+    metric_kind metric = metric_kind::CHEBYSHEV;
+    std::uint64_t seed = 1;
+};
+
+struct sampled_position {
+    board position;
+    int player;
+    bool opening;
+};
+
+static bool parse_metric(const std::string& name, metric_kind& out)
+{
+    if (name == "manhattan") out = metric_kind::MANHATTAN;
+    else if (name == "euclidean") out = metric_kind::EUCLIDEAN;
+    else if (name == "chebyshev") out = metric_kind::CHEBYSHEV;
+    else return false;
+
+    return true;
+}
+
+// Plays one game and returns the positions of both books it went through
+static std::vector<sampled_position> sample_game(const board& start, std::uint64_t seed,
+    const book_options& options)
+{
+    std::vector<sampled_position> samples;
+    board brd = start;
+
+    std::mt19937_64 random(seed);
+    int ply = 0;
+    for (; ply < options.random_plies && !brd.get_winner(); ++ply) {
+        auto moves = brd.get_legal_moves(ply % 2 + 1);
+        if (moves.empty()) {
+            return samples;
+        }
+        brd.move_piece(moves[random() % moves.size()]);
+    }
+
+    minimax players[2] = { minimax(1, 1), minimax(2, 2) };
+    for (auto& player : players) {
+        player.set_depth(options.play_depth);
+    }
+
+    for (; ply < options.max_plies && !brd.get_winner(); ++ply) {
+        int player = ply % 2 + 1;
+
+        // A position without a move has nothing to put in a book
+        if (brd.get_legal_moves(player).empty()) {
+            break;
+        }
+
+        bool opening = ply < options.opening_plies;
+        if (opening || brd.get_pieces_outside_camp(player) <= options.outside) {
+            samples.push_back({ brd, player, opening });
+        }
+
+        players[player - 1].make_next_move(brd);
+    }
+
+    return samples;
+}
+
+int main(int argc, char* argv[])
+{
+    book_options options;
+    const char* input_path = "in.txt";
+    const char* opening_path = "opening.bin";
+    const char* endgame_path = "endgame.bin";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            options.games = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--play-depth") == 0 && i + 1 < argc) {
+            options.play_depth = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            options.depth = std::clamp(std::atoi(argv[++i]), 1, 255);
+        }
+        else if (std::strcmp(argv[i], "--opening-plies") == 0 && i + 1 < argc) {
+            options.opening_plies = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--outside") == 0 && i + 1 < argc) {
+            options.outside = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--random-plies") == 0 && i + 1 < argc) {
+            options.random_plies = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc) {
+            options.max_plies = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            if (!parse_metric(argv[++i], options.metric)) {
+                std::cerr << "Nieznana metryka " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--opening") == 0 && i + 1 < argc) {
+            opening_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--endgame") == 0 && i + 1 < argc) {
+            endgame_path = argv[++i];
+        }
+    }
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    board start;
+    start.set_metric_one(options.metric);
+    start.set_metric_two(options.metric);
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            int tmp;
+            input >> tmp;
+            start.set_piece(x, y, tmp);
+        }
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // Workers take games and then positions by index, so a run does not
+    // depend on the number of workers apart from ties between best moves
+    auto run_workers = [&](auto&& work) {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < options.workers; ++i) {
+            workers.emplace_back(work);
+        }
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    };
+
+    std::vector<std::vector<sampled_position>> games(options.games);
+    std::atomic<int> next_game = 0;
+
+    run_workers([&] {
+        for (int i = next_game++; i < options.games; i = next_game++) {
+            games[i] = sample_game(start, options.seed * 1'000'003 + i, options);
+        }
+    });
+
+    // Every position is searched once, as an opening if any game reached
+    // it among its first plies
+    std::vector<sampled_position> positions;
+    for (auto& game : games) {
+        positions.insert(positions.end(), game.begin(), game.end());
+    }
+
+    auto key = [](const sampled_position& sample) { return sample.position.hash_position(sample.player); };
+    std::sort(positions.begin(), positions.end(), [&](const sampled_position& first, const sampled_position& second) {
+        return key(first) != key(second) ? key(first) < key(second) : first.opening > second.opening;
+        });
+    positions.erase(std::unique(positions.begin(), positions.end(),
+        [&](const sampled_position& first, const sampled_position& second) { return key(first) == key(second); }),
+        positions.end());
+
+    std::cout << "Rozegrano " << options.games << " partii, pozycje do przeszukania: "
+        << positions.size() << std::endl;
+
+    std::vector<position_book::entry> entries(positions.size());
+    std::atomic<int> next_position = 0;
+
+    run_workers([&] {
+        minimax players[2] = { minimax(1, 1), minimax(2, 2) };
+        for (auto& player : players) {
+            player.set_depth(options.depth);
+        }
+
+        int count = static_cast<int>(positions.size());
+        for (int i = next_position++; i < count; i = next_position++) {
+            auto& sample = positions[i];
+            auto move = players[sample.player - 1].find_next_move(sample.position);
+            entries[i] = position_book::entry{
+                .key = key(sample),
+                .x1 = static_cast<std::uint8_t>(move.x1),
+                .y1 = static_cast<std::uint8_t>(move.y1),
+                .x2 = static_cast<std::uint8_t>(move.x2),
+                .y2 = static_cast<std::uint8_t>(move.y2),
+                .depth = static_cast<std::uint8_t>(options.depth),
+                .reserved = {},
+            };
+        }
+    });
+
+    std::vector<position_book::entry> opening;
+    std::vector<position_book::entry> endgame;
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        (positions[i].opening ? opening : endgame).push_back(entries[i]);
+    }
+
+    bool ok = true;
+    for (auto [path, book] : { std::pair{ opening_path, &opening }, std::pair{ endgame_path, &endgame } }) {
+        if (position_book::write(path, *book)) {
+            std::cout << "Zapisano " << book->size() << " pozycji do " << path << std::endl;
+        }
+        else {
+            std::cerr << "Nie mozna zapisac pliku " << path << std::endl;
+            ok = false;
+        }
+    }
+
+    std::cout << "Czas: " << std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time) << std::endl;
+
+    return ok ? 0 : 1;
+}
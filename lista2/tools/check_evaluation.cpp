@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "board.hpp"
+
+// Compares the batch scores of evaluate_moves(), which run the AVX2 kernel
+// on CPUs that have it, with making every move and reading the heuristic,
+// which scores the terms one position at a time. Positions come from random
+// games on every board size, with random metrics and term weights, and
+// every move of both players is checked with both heuristics.
+//
+// Usage: check_evaluation [--games N] [--plies N] [--seed N]
+
+static const metric_kind METRICS[] = {
+    metric_kind::MANHATTAN,
+    metric_kind::EUCLIDEAN,
+    metric_kind::CHEBYSHEV,
+};
+
+static evaluation_terms random_terms(std::mt19937& random)
+{
+    evaluation_terms terms;
+    terms.spread = random() % 5;
+    terms.straggler = random() % 40;
+    terms.straggler_margin = random() % 3000;
+    terms.camp = random() % 500;
+    return terms;
+}
+
+// Pieces start in the camp of the opponent they head for
+template <typename Layout>
+static void set_start_position(basic_board<Layout>& brd)
+{
+    constexpr int size = Layout::SIZE;
+
+    for (int x = 0; x < static_cast<int>(Layout::CAMP_ROWS.size()); ++x) {
+        for (int y = 0; y < Layout::CAMP_ROWS[x]; ++y) {
+            brd.set_piece(x, y, 2);
+            brd.set_piece(size - 1 - x, size - 1 - y, 1);
+        }
+    }
+}
+
+// Returns the number of moves whose batch score differs
+template <typename Layout>
+static int check_position(basic_board<Layout>& brd)
+{
+    int errors = 0;
+
+    for (int player = 1; player <= 2; ++player) {
+        auto moves = brd.get_legal_moves(player);
+        std::vector<std::int64_t> scores(moves.size());
+
+        for (int which = 1; which <= 2; ++which) {
+            brd.evaluate_moves(player, which, moves.data(), static_cast<int>(moves.size()), scores.data());
+
+            for (std::size_t i = 0; i < moves.size(); ++i) {
+                brd.move_piece(moves[i]);
+                std::int64_t expected = which == 1 ? brd.get_heuristic_one() : brd.get_heuristic_two();
+                brd.undo_move(moves[i]);
+
+                errors += scores[i] != expected;
+            }
+        }
+    }
+
+    return errors;
+}
+
+template <typename Layout>
+static int run_layout(const char* name, int game_count, int max_plies, std::mt19937& random)
+{
+    int errors = 0;
+    std::uint64_t checked = 0;
+
+    for (int game = 0; game < game_count; ++game) {
+        basic_board<Layout> brd;
+        brd.set_metric_one(METRICS[random() % std::size(METRICS)]);
+        brd.set_metric_two(METRICS[random() % std::size(METRICS)]);
+        brd.set_terms_one(random_terms(random));
+        brd.set_terms_two(random_terms(random));
+        set_start_position(brd);
+
+        for (int ply = 0; ply < max_plies && !brd.get_winner(); ++ply) {
+            errors += check_position(brd);
+            ++checked;
+
+            auto moves = brd.get_legal_moves(ply % 2 + 1);
+            if (moves.empty()) {
+                break;
+            }
+            brd.move_piece(moves[random() % moves.size()]);
+        }
+    }
+
+    std::cout << "Plansza: " << name << ", pozycje: " << checked;
+    if (errors) {
+        std::cout << ", BLEDNE OCENY: " << errors << std::endl;
+    }
+    else {
+        std::cout << " OK" << std::endl;
+    }
+
+    return errors;
+}
+
+int main(int argc, char* argv[])
+{
+    int game_count = 10;
+    int max_plies = 200;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            game_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+            max_plies = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+    }
+
+    std::cout << "Ocena ruchow: " << (evaluation_uses_avx2() ? "AVX2" : "skalarna") << std::endl;
+
+    std::mt19937 random(seed);
+    int errors = run_layout<halma_16>("16x16", game_count, max_plies, random);
+    errors += run_layout<halma_10>("10x10", game_count, max_plies, random);
+    errors += run_layout<halma_8>("8x8", game_count, max_plies, random);
+
+    bool ok = errors == 0;
+    std::cout << (ok ? "Wszystkie oceny zgodne" : "Oceny niezgodne z ocena po ruchu") << std::endl;
+    return ok ? 0 : 1;
+}
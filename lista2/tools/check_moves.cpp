@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "board.hpp"
+
+// Plays random move sequences on every board size and takes them back. After
+// every move and every undo, whatever the moves keep up to date (piece lists,
+// occupancy, camp counts, heuristic sums and hash) is compared with a full
+// recompute from the cells, and the public values with a board set up from
+// scratch. Once all moves are taken back the starting position and its hash
+// have to be restored exactly.
+//
+// Usage: check_moves [--games N] [--plies N] [--seed N]
+
+// Pieces start in the camp of the opponent they head for
+template <typename Layout>
+static void set_start_position(basic_board<Layout>& brd)
+{
+    constexpr int size = Layout::SIZE;
+
+    for (int x = 0; x < static_cast<int>(Layout::CAMP_ROWS.size()); ++x) {
+        for (int y = 0; y < Layout::CAMP_ROWS[x]; ++y) {
+            brd.set_piece(x, y, 2);
+            brd.set_piece(size - 1 - x, size - 1 - y, 1);
+        }
+    }
+}
+
+template <typename Layout>
+static bool matches_fresh_board(const basic_board<Layout>& brd)
+{
+    if (!brd.check_invariants()) {
+        return false;
+    }
+
+    basic_board<Layout> fresh;
+    fresh.set_metric_one(metric_kind::EUCLIDEAN);
+    fresh.set_metric_two(metric_kind::CHEBYSHEV);
+
+    for (int x = 0; x < Layout::SIZE; ++x) {
+        for (int y = 0; y < Layout::SIZE; ++y) {
+            fresh.set_piece(x, y, brd.get_piece(x, y));
+        }
+    }
+
+    return fresh.hash_position() == brd.hash_position()
+        && fresh.get_heuristic_one() == brd.get_heuristic_one()
+        && fresh.get_heuristic_two() == brd.get_heuristic_two()
+        && fresh.get_pieces_outside_camp(1) == brd.get_pieces_outside_camp(1)
+        && fresh.get_pieces_outside_camp(2) == brd.get_pieces_outside_camp(2)
+        && fresh.get_winner() == brd.get_winner();
+}
+
+// Returns the number of steps whose state differs from the recompute
+template <typename Layout>
+static int run_layout(const char* name, int game_count, int max_plies, std::mt19937& random)
+{
+    using board_type = basic_board<Layout>;
+
+    int errors = 0;
+    int steps = 0;
+
+    for (int game = 0; game < game_count; ++game) {
+        board_type brd;
+        brd.set_metric_one(metric_kind::EUCLIDEAN);
+        brd.set_metric_two(metric_kind::CHEBYSHEV);
+        set_start_position(brd);
+
+        std::uint8_t start[Layout::SIZE][Layout::SIZE];
+        brd.copy_position(start);
+        std::uint64_t start_hash = brd.hash_position();
+
+        std::vector<typename board_type::move> played;
+        for (int ply = 0; ply < max_plies && !brd.get_winner(); ++ply) {
+            auto moves = brd.get_legal_moves(ply % 2 + 1);
+            if (moves.empty()) {
+                break;
+            }
+
+            auto move = moves[random() % moves.size()];
+            brd.move_piece(move);
+            played.push_back(move);
+
+            errors += !matches_fresh_board(brd);
+            ++steps;
+        }
+
+        while (!played.empty()) {
+            brd.undo_move(played.back());
+            played.pop_back();
+
+            errors += !matches_fresh_board(brd);
+            ++steps;
+        }
+
+        errors += !brd.compare_position(start) || brd.hash_position() != start_hash;
+    }
+
+    std::cout << "Plansza: " << name << ", partie: " << game_count << ", kroki: " << steps;
+    if (errors) {
+        std::cout << ", BLEDNE STANY: " << errors << std::endl;
+    }
+    else {
+        std::cout << " OK" << std::endl;
+    }
+
+    return errors;
+}
+
+int main(int argc, char* argv[])
+{
+    int game_count = 20;
+    int max_plies = 300;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            game_count = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+            max_plies = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+    }
+
+    std::mt19937 random(seed);
+    int errors = run_layout<halma_16>("16x16", game_count, max_plies, random);
+    errors += run_layout<halma_10>("10x10", game_count, max_plies, random);
+    errors += run_layout<halma_8>("8x8", game_count, max_plies, random);
+
+    bool ok = errors == 0;
+    std::cout << (ok ? "Wszystkie stany zgodne" : "Stany niezgodne z przeliczeniem") << std::endl;
+    return ok ? 0 : 1;
+}
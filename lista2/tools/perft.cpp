@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "board.hpp"
+
+// Counts the leaves of the game tree to a fixed depth, which only depends
+// on the move generator. Positions with a winner have no moves, at the
+// last ply the moves are counted without being made.
+//
+// Usage: perft [--depth N] [--input in.txt]
+
+// Deep enough to cover every kind of jump chain while taking under a second,
+// deeper reference counts are checked with --depth
+static const int DEFAULT_DEPTH = 3;
+
+struct perft_position {
+    const char* name;
+    int player;
+    const char* rows[board::SIZE];
+    std::vector<std::uint64_t> counts;
+};
+
+// Reference counts of the starting position from in.txt, depth 1 first.
+// All counts were cross-checked against a naive generator that follows
+// jump chains cell by cell.
+static const std::vector<std::uint64_t> START_COUNTS = { 40, 1600, 85440, 4562496, 289844520 };
+
+// Positions of an engine game started from in.txt, rows are y and
+// characters are x as in in.txt
+static const perft_position MIDGAME_POSITIONS[] = {
+    {
+        "ruch 20", 1,
+        {
+            "2200200000000000",
+            "0000200200000000",
+            "2020000002000000",
+            "2220002220000000",
+            "2200000202200000",
+            "0000000000000000",
+            "0000000000000000",
+            "0000000000000000",
+            "0000000001000000",
+            "0000000001100000",
+            "0000000001110000",
+            "0000000000100011",
+            "0000000000010110",
+            "0000000000001111",
+            "0000000000001000",
+            "0000000000000101",
+        },
+        { 132, 19536, 2707808, 401551538 },
+    },
+    {
+        "ruch 50", 1,
+        {
+            "2200200000000000",
+            "0000200200000000",
+            "0020000002000000",
+            "0020001020000000",
+            "2000000200000000",
+            "0000000000002000",
+            "0000000100000220",
+            "0000001010000002",
+            "0000000111000000",
+            "0000000001110000",
+            "0000000001100000",
+            "0000020000010001",
+            "0000020000100100",
+            "0000002000001100",
+            "0000002000000000",
+            "0000000000000001",
+        },
+        { 179, 27508, 5083935, 779520013 },
+    },
+    {
+        "ruch 90", 2,
+        {
+            "1000000000000000",
+            "1110000220000000",
+            "0102010000000000",
+            "0000000000200000",
+            "2001000002002000",
+            "0000001000000200",
+            "0000201010000020",
+            "0000001010000022",
+            "0000001000000002",
+            "0000000002010002",
+            "0000000000000010",
+            "0000000000010000",
+            "0000020000000100",
+            "0000000000000100",
+            "0000002000000000",
+            "0000000220000001",
+        },
+        { 153, 24386, 3764230, 608650071 },
+    },
+};
+
+static std::uint64_t perft(board& brd, int player, int depth, board::move* moves)
+{
+    if (depth == 0) return 1;
+    if (brd.get_winner()) return 0;
+
+    int move_count = brd.get_legal_moves(player, moves);
+    if (depth == 1) return move_count;
+
+    std::uint64_t leaves = 0;
+    for (int i = 0; i < move_count; ++i) {
+        brd.move_piece(moves[i]);
+        leaves += perft(brd, 3 - player, depth - 1, moves + move_count);
+        brd.undo_move(moves[i]);
+    }
+
+    return leaves;
+}
+
+// Runs every depth up to max_depth, returns false if any count differs
+// from its reference
+static bool run_position(const char* name, board& brd, int player,
+    const std::vector<std::uint64_t>& counts, int max_depth)
+{
+    bool ok = true;
+    std::vector<board::move> moves(static_cast<std::size_t>(board::MAX_MOVES) * max_depth);
+
+    std::cout << "Pozycja: " << name << ", gracz " << player << std::endl;
+
+    for (int depth = 1; depth <= max_depth; ++depth) {
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t leaves = perft(brd, player, depth, moves.data());
+        auto duration = std::chrono::steady_clock::now() - start;
+        double seconds = std::chrono::duration<double>(duration).count();
+
+        std::cout << "  glebokosc " << depth
+            << ": " << leaves << " lisci"
+            << ", czas: " << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+            << ", lisci/s: " << static_cast<std::uint64_t>(seconds > 0 ? leaves / seconds : 0);
+
+        if (depth <= static_cast<int>(counts.size())) {
+            if (leaves == counts[depth - 1]) {
+                std::cout << " OK";
+            }
+            else {
+                std::cout << " BLAD, oczekiwano " << counts[depth - 1];
+                ok = false;
+            }
+        }
+
+        std::cout << std::endl;
+    }
+
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int max_depth = DEFAULT_DEPTH;
+    const char* input_path = "in.txt";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            max_depth = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+    }
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    board start;
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            int tmp;
+            input >> tmp;
+            start.set_piece(x, y, tmp);
+        }
+    }
+
+    bool ok = run_position(input_path, start, 1, START_COUNTS, max_depth);
+
+    for (const auto& position : MIDGAME_POSITIONS) {
+        board brd;
+        for (int y = 0; y < board::SIZE; ++y) {
+            for (int x = 0; x < board::SIZE; ++x) {
+                brd.set_piece(x, y, position.rows[y][x] - '0');
+            }
+        }
+
+        ok = run_position(position.name, brd, position.player, position.counts, max_depth) && ok;
+    }
+
+    std::cout << (ok ? "Wszystkie liczby zgodne" : "Liczby niezgodne z wzorcowymi") << std::endl;
+    return ok ? 0 : 1;
+}
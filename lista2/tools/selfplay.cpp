@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "minimax.hpp"
+#include "packed_position.hpp"
+
+// Plays minimax against itself on parallel worker threads and writes every
+// position of every game with the game's result, the training data of the
+// tune tool. Games open with random plies and later moves are random with
+// a small probability, so that the games do not all follow one line.
+// Games reaching the ply limit are won by the player whose pieces are
+// closer to their corner in total, as in tournament.
+//
+// Usage: selfplay [--games N] [--workers N] [--depth N] [--random-plies N]
+//     [--random-moves PERCENT] [--max-plies N] [--metric NAME]
+//     [--weights FILE] [--seed N] [--input in.txt] [--output positions.bin]
+
+struct selfplay_options {
+    int games = 1000;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    int depth = 1;
+    int random_plies = 8;
+    int random_moves = 5;
+    int max_plies = 400;
+    metric_kind metric = metric_kind::MANHATTAN;
+    const distance_tables<board::SIZE>* tables = nullptr;
+    std::uint64_t seed = 1;
+};
+
+struct game_record {
+    std::vector<training_position> positions;
+    int winner;
+};
+
+static bool parse_metric(const std::string& name, metric_kind& out)
+{
+    if (name == "manhattan") out = metric_kind::MANHATTAN;
+    else if (name == "euclidean") out = metric_kind::EUCLIDEAN;
+    else if (name == "chebyshev") out = metric_kind::CHEBYSHEV;
+    else return false;
+
+    return true;
+}
+
+// Total Chebyshev distance of a player's pieces from the corner it heads
+// for, the first player heads for (0, 0)
+static int remaining_distance(const board& brd, int player)
+{
+    int distance = 0;
+
+    for (int x = 0; x < board::SIZE; ++x) {
+        for (int y = 0; y < board::SIZE; ++y) {
+            if (brd.get_piece(x, y) == player) {
+                distance += player == 1 ? std::max(x, y)
+                    : std::max(board::SIZE - 1 - x, board::SIZE - 1 - y);
+            }
+        }
+    }
+
+    return distance;
+}
+
+// A player left with no legal move ends the game, which is then decided
+// by distance like one reaching the ply limit
+static game_record play_game(const board& start, minimax (&players)[2], std::uint64_t seed,
+    const selfplay_options& options)
+{
+    game_record record{};
+    board brd = start;
+    std::mt19937_64 random(seed);
+
+    for (auto& player : players) {
+        player.new_search();
+    }
+
+    int ply = 0;
+    for (; ply < options.random_plies && !brd.get_winner(); ++ply) {
+        auto moves = brd.get_legal_moves(ply % 2 + 1);
+        if (moves.empty()) {
+            break;
+        }
+        brd.move_piece(moves[random() % moves.size()]);
+    }
+
+    for (; ply < options.max_plies && !brd.get_winner(); ++ply) {
+        int player = ply % 2 + 1;
+        auto moves = brd.get_legal_moves(player);
+        if (moves.empty()) {
+            break;
+        }
+
+        record.positions.push_back({ packed_position::pack(brd, player), 0 });
+
+        if (static_cast<int>(random() % 100) < options.random_moves) {
+            brd.move_piece(moves[random() % moves.size()]);
+        }
+        else {
+            players[player - 1].make_next_move(brd);
+        }
+    }
+
+    record.winner = brd.get_winner();
+    if (!record.winner) {
+        int first_distance = remaining_distance(brd, 1);
+        int second_distance = remaining_distance(brd, 2);
+        record.winner = first_distance < second_distance ? 1
+            : second_distance < first_distance ? 2 : 0;
+    }
+
+    std::uint8_t result = record.winner == 1 ? 2 : record.winner == 2 ? 0 : 1;
+    for (auto& position : record.positions) {
+        position.result = result;
+    }
+
+    return record;
+}
+
+int main(int argc, char* argv[])
+{
+    selfplay_options options;
+    const char* input_path = "in.txt";
+    const char* output_path = "positions.bin";
+    distance_tables<board::SIZE> tables;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            options.games = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            options.depth = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--random-plies") == 0 && i + 1 < argc) {
+            options.random_plies = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--random-moves") == 0 && i + 1 < argc) {
+            options.random_moves = std::clamp(std::atoi(argv[++i]), 0, 100);
+        }
+        else if (std::strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc) {
+            options.max_plies = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            if (!parse_metric(argv[++i], options.metric)) {
+                std::cerr << "Nieznana metryka " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+            std::ifstream weights(argv[++i]);
+            if (!read_distance_tables(weights, tables)) {
+                std::cerr << "Nie mozna wczytac wag z pliku " << argv[i] << std::endl;
+                return 1;
+            }
+
+            options.tables = &tables;
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        }
+    }
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    board start;
+    if (options.tables) {
+        start.set_tables_one(options.tables);
+        start.set_tables_two(options.tables);
+    }
+    else {
+        start.set_metric_one(options.metric);
+        start.set_metric_two(options.metric);
+    }
+
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            int tmp;
+            input >> tmp;
+            start.set_piece(x, y, tmp);
+        }
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // Workers take games by index, so the output does not depend on the
+    // number of workers apart from ties between best moves. Every worker
+    // keeps one engine per player for all its games, so their
+    // transposition tables are allocated once per run.
+    std::vector<game_record> games(options.games);
+    std::atomic<int> next_game = 0;
+
+    auto worker = [&] {
+        minimax players[2] = { minimax(1, 1), minimax(2, 2) };
+        for (auto& player : players) {
+            player.set_depth(options.depth);
+        }
+
+        for (int i = next_game++; i < options.games; i = next_game++) {
+            games[i] = play_game(start, players, options.seed * 1'000'003 + i, options);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.workers; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    std::vector<training_position> positions;
+    int wins[3] = {};
+    for (auto& game : games) {
+        positions.insert(positions.end(), game.positions.begin(), game.positions.end());
+        ++wins[game.winner];
+    }
+
+    auto duration = std::chrono::steady_clock::now() - start_time;
+    double seconds = std::chrono::duration<double>(duration).count();
+
+    if (!write_training_positions(output_path, positions)) {
+        std::cerr << "Nie mozna zapisac pliku " << output_path << std::endl;
+        return 1;
+    }
+
+    std::cout << "Rozegrano " << options.games << " partii (wygrane pierwszego gracza " << wins[1]
+        << ", drugiego " << wins[2] << ", remisy " << wins[0] << ")"
+        << ", zapisano " << positions.size() << " pozycji do " << output_path
+        << " w " << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        << " (" << static_cast<std::uint64_t>(seconds > 0 ? positions.size() / seconds : 0)
+        << " pozycji/s, watki: " << options.workers << ")" << std::endl;
+
+    return 0;
+}
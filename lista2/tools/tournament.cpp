@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "mcts.hpp"
+#include "minimax.hpp"
+
+// Plays games between minimax configurations on parallel worker threads.
+// Every pair of configurations plays the given number of games from
+// in.txt. A game opens with a few random plies so that games differ, and
+// every opening is played twice with the seats swapped. Games reaching the
+// ply limit are won by the player whose pieces are closer to their corner
+// in total, or drawn if both are equally close. The heuristic of
+// a player is the one of its seat, computed with the player's metric.
+// A configuration is either a minimax depth or mcts, optionally followed by
+// the weights of the evaluation terms of its heuristic. With --time-limit
+// every player gets the same time per move and minimax deepens
+// iteratively up to its depth. Speed is reported in nodes for minimax and
+// in iterations for mcts, the two are not comparable.
+//
+// Usage: tournament [--config DEPTH,METRIC[,SPREAD,STRAGGLER,MARGIN,CAMP]
+//     | --config mcts,METRIC[,SPREAD,STRAGGLER,MARGIN,CAMP]]...
+//     [--games N] [--workers N] [--time-limit MS] [--random-plies N]
+//     [--max-plies N] [--seed N] [--input in.txt] [--csv games.csv]
+//     [--json summary.json]
+
+enum class engine_kind {
+    MINIMAX,
+    MCTS,
+};
+
+struct player_config {
+    engine_kind engine;
+    int depth;
+    metric_kind metric;
+    evaluation_terms terms;
+    std::string name;
+};
+
+struct game_result {
+    // Configurations of the first and the second player
+    int config[2];
+    // 1 or 2, or 0 for a draw
+    int winner;
+    // Whether the ply limit ran out and the winner was decided by distance
+    bool adjudicated;
+    int plies;
+    int moves[2];
+    // Nodes searched by minimax and iterations run by mcts, which are not
+    // comparable and are kept apart
+    std::uint64_t nodes[2];
+    std::uint64_t iterations[2];
+    std::chrono::nanoseconds think_time[2];
+};
+
+struct tournament_options {
+    int games_per_pair = 10;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    int random_plies = 4;
+    int max_plies = 400;
+    std::chrono::milliseconds time_limit{ 0 };
+    std::uint64_t seed = 1;
+};
+
+static const char* metric_name(metric_kind metric)
+{
+    switch (metric) {
+    case metric_kind::EUCLIDEAN: return "euclidean";
+    case metric_kind::CHEBYSHEV: return "chebyshev";
+    default: return "manhattan";
+    }
+}
+
+// Parses "DEPTH,METRIC" or "mcts,METRIC", e.g. "3,chebyshev", with
+// optional terms, e.g. "3,chebyshev,1,2,2,1"
+static bool parse_config(const char* text, player_config& out)
+{
+    const char* comma = std::strchr(text, ',');
+    if (!comma) return false;
+
+    std::string engine(text, comma);
+    out.engine = engine == "mcts" ? engine_kind::MCTS : engine_kind::MINIMAX;
+    out.depth = out.engine == engine_kind::MCTS ? 0 : std::atoi(text);
+    if (out.engine == engine_kind::MINIMAX && out.depth < 1) return false;
+
+    const char* terms = std::strchr(comma + 1, ',');
+    std::string metric = terms ? std::string(comma + 1, terms) : std::string(comma + 1);
+    if (metric == "manhattan") out.metric = metric_kind::MANHATTAN;
+    else if (metric == "euclidean") out.metric = metric_kind::EUCLIDEAN;
+    else if (metric == "chebyshev") out.metric = metric_kind::CHEBYSHEV;
+    else return false;
+
+    out.name = (out.engine == engine_kind::MCTS ? "mcts" : "d" + std::to_string(out.depth)) + "-" + metric;
+    out.terms = evaluation_terms{};
+    if (terms) {
+        if (std::sscanf(terms + 1, "%d,%d,%d,%d", &out.terms.spread, &out.terms.straggler,
+            &out.terms.straggler_margin, &out.terms.camp) != 4) {
+            return false;
+        }
+
+        out.name += "-terms" + std::string(terms);
+    }
+
+    return true;
+}
+
+// One player of a game, whichever engine it uses
+class player_engine {
+public:
+    player_engine(const player_config& config, int player, const tournament_options& options)
+    {
+        if (config.engine == engine_kind::MCTS) {
+            _mcts = std::make_unique<mcts>(player, player);
+            _mcts->set_time_limit(options.time_limit);
+        }
+        else {
+            _minimax = std::make_unique<minimax>(player, player);
+            _minimax->set_depth(config.depth);
+            _minimax->set_time_limit(options.time_limit);
+        }
+    }
+
+    // Nodes or iterations, see counts_iterations(), or -1 if no move was made
+    int make_next_move(board& brd)
+    {
+        return _mcts ? _mcts->make_next_move(brd) : _minimax->make_next_move(brd);
+    }
+
+    bool counts_iterations() const
+    {
+        return _mcts != nullptr;
+    }
+
+private:
+    std::unique_ptr<minimax> _minimax;
+    std::unique_ptr<mcts> _mcts;
+};
+
+// Total Chebyshev distance of a player's pieces from the corner it heads
+// for, the first player heads for (0, 0)
+static int remaining_distance(const board& brd, int player)
+{
+    int distance = 0;
+
+    for (int x = 0; x < board::SIZE; ++x) {
+        for (int y = 0; y < board::SIZE; ++y) {
+            if (brd.get_piece(x, y) == player) {
+                distance += player == 1 ? std::max(x, y)
+                    : std::max(board::SIZE - 1 - x, board::SIZE - 1 - y);
+            }
+        }
+    }
+
+    return distance;
+}
+
+static game_result play_game(const board& start, const std::vector<player_config>& configs,
+    int first, int second, std::uint64_t opening_seed, const tournament_options& options)
+{
+    game_result result{
+        .config = { first, second },
+        .winner = 0,
+        .adjudicated = false,
+        .plies = 0,
+        .moves = {},
+        .nodes = {},
+        .iterations = {},
+        .think_time = {},
+    };
+
+    board brd = start;
+    brd.set_metric_one(configs[first].metric);
+    brd.set_metric_two(configs[second].metric);
+    brd.set_terms_one(configs[first].terms);
+    brd.set_terms_two(configs[second].terms);
+
+    std::mt19937_64 random(opening_seed);
+    for (; result.plies < options.random_plies; ++result.plies) {
+        auto moves = brd.get_legal_moves(result.plies % 2 + 1);
+        if (moves.empty()) {
+            break;
+        }
+        brd.move_piece(moves[random() % moves.size()]);
+    }
+
+    player_engine players[2] = {
+        player_engine(configs[first], 1, options),
+        player_engine(configs[second], 2, options),
+    };
+
+    while (!brd.get_winner() && result.plies < options.max_plies) {
+        int seat = result.plies % 2;
+
+        auto move_start = std::chrono::steady_clock::now();
+        int searched = players[seat].make_next_move(brd);
+        result.think_time[seat] += std::chrono::steady_clock::now() - move_start;
+
+        // A player left with no move ends the game, which is then
+        // decided by distance
+        if (searched < 0) {
+            break;
+        }
+
+        (players[seat].counts_iterations() ? result.iterations : result.nodes)[seat] += searched;
+
+        ++result.moves[seat];
+        ++result.plies;
+    }
+
+    result.winner = brd.get_winner();
+    if (!result.winner) {
+        int first_distance = remaining_distance(brd, 1);
+        int second_distance = remaining_distance(brd, 2);
+
+        result.adjudicated = true;
+        result.winner = first_distance < second_distance ? 1
+            : second_distance < first_distance ? 2 : 0;
+    }
+
+    return result;
+}
+
+static void write_csv(const char* path, const std::vector<player_config>& configs,
+    const std::vector<game_result>& results)
+{
+    std::ofstream out(path);
+    out << "game,first,second,winner,adjudicated,plies,first_moves,second_moves,"
+        "first_nodes,second_nodes,first_iterations,second_iterations,first_time_ms,second_time_ms\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& game = results[i];
+        out << i << ',' << configs[game.config[0]].name << ',' << configs[game.config[1]].name
+            << ',' << game.winner << ',' << game.adjudicated << ',' << game.plies
+            << ',' << game.moves[0] << ',' << game.moves[1]
+            << ',' << game.nodes[0] << ',' << game.nodes[1]
+            << ',' << game.iterations[0] << ',' << game.iterations[1]
+            << ',' << game.think_time[0].count() / 1e6 << ',' << game.think_time[1].count() / 1e6
+            << '\n';
+    }
+}
+
+struct config_summary {
+    int games;
+    int wins;
+    int losses;
+    int draws;
+    int moves;
+    std::uint64_t nodes;
+    std::uint64_t iterations;
+    std::chrono::nanoseconds think_time;
+    std::uint64_t plies;
+};
+
+static std::vector<config_summary> summarize(const std::vector<player_config>& configs,
+    const std::vector<game_result>& results)
+{
+    std::vector<config_summary> summaries(configs.size());
+
+    for (const auto& game : results) {
+        for (int seat = 0; seat < 2; ++seat) {
+            auto& summary = summaries[game.config[seat]];
+            ++summary.games;
+            summary.moves += game.moves[seat];
+            summary.nodes += game.nodes[seat];
+            summary.iterations += game.iterations[seat];
+            summary.think_time += game.think_time[seat];
+            summary.plies += game.plies;
+
+            if (game.winner == 0) ++summary.draws;
+            else if (game.winner == seat + 1) ++summary.wins;
+            else ++summary.losses;
+        }
+    }
+
+    return summaries;
+}
+
+static double win_rate(const config_summary& summary)
+{
+    return summary.games ? (summary.wins + 0.5 * summary.draws) / summary.games : 0.0;
+}
+
+static double average_move_ms(const config_summary& summary)
+{
+    return summary.moves ? summary.think_time.count() / 1e6 / summary.moves : 0.0;
+}
+
+static double nodes_per_second(const config_summary& summary)
+{
+    double seconds = std::chrono::duration<double>(summary.think_time).count();
+    return seconds > 0 ? summary.nodes / seconds : 0.0;
+}
+
+static double iterations_per_second(const config_summary& summary)
+{
+    double seconds = std::chrono::duration<double>(summary.think_time).count();
+    return seconds > 0 ? summary.iterations / seconds : 0.0;
+}
+
+static double average_plies(const config_summary& summary)
+{
+    return summary.games ? static_cast<double>(summary.plies) / summary.games : 0.0;
+}
+
+static void write_json(const char* path, const std::vector<player_config>& configs,
+    const std::vector<config_summary>& summaries, const std::vector<game_result>& results)
+{
+    std::ofstream out(path);
+    out << "{\n  \"configs\": [\n";
+
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        const auto& summary = summaries[i];
+        out << "    {\"name\": \"" << configs[i].name << "\""
+            << ", \"engine\": \"" << (configs[i].engine == engine_kind::MCTS ? "mcts" : "minimax") << "\""
+            << ", \"depth\": " << configs[i].depth
+            << ", \"metric\": \"" << metric_name(configs[i].metric) << "\""
+            << ", \"games\": " << summary.games
+            << ", \"wins\": " << summary.wins
+            << ", \"losses\": " << summary.losses
+            << ", \"draws\": " << summary.draws
+            << ", \"win_rate\": " << win_rate(summary)
+            << ", \"average_move_ms\": " << average_move_ms(summary)
+            << ", \"nodes_per_second\": " << nodes_per_second(summary)
+            << ", \"iterations_per_second\": " << iterations_per_second(summary)
+            << ", \"average_plies\": " << average_plies(summary)
+            << "}" << (i + 1 < configs.size() ? "," : "") << "\n";
+    }
+
+    out << "  ],\n  \"games\": [\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& game = results[i];
+        out << "    {\"first\": \"" << configs[game.config[0]].name << "\""
+            << ", \"second\": \"" << configs[game.config[1]].name << "\""
+            << ", \"winner\": " << game.winner
+            << ", \"adjudicated\": " << (game.adjudicated ? "true" : "false")
+            << ", \"plies\": " << game.plies
+            << ", \"nodes\": [" << game.nodes[0] << ", " << game.nodes[1] << "]"
+            << ", \"iterations\": [" << game.iterations[0] << ", " << game.iterations[1] << "]"
+            << ", \"time_ms\": [" << game.think_time[0].count() / 1e6
+            << ", " << game.think_time[1].count() / 1e6 << "]"
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<player_config> configs;
+    tournament_options options;
+    const char* input_path = "in.txt";
+    const char* csv_path = nullptr;
+    const char* json_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            player_config config;
+            if (!parse_config(argv[++i], config)) {
+                std::cerr << "Niepoprawna konfiguracja: " << argv[i]
+                    << " (oczekiwano GLEBOKOSC,METRYKA lub mcts,METRYKA)" << std::endl;
+                return 1;
+            }
+            configs.push_back(config);
+        }
+        else if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            options.games_per_pair = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+            options.time_limit = std::chrono::milliseconds(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--random-plies") == 0 && i + 1 < argc) {
+            options.random_plies = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc) {
+            options.max_plies = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+    }
+
+    if (configs.size() < 2) {
+        player_config config;
+        configs.clear();
+        parse_config("2,manhattan", config);
+        configs.push_back(config);
+        parse_config("2,chebyshev", config);
+        configs.push_back(config);
+    }
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "Nie mozna otworzyc pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    board start;
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            int tmp;
+            input >> tmp;
+            start.set_piece(x, y, tmp);
+        }
+    }
+
+    std::vector<std::pair<int, int>> pairs;
+    for (int a = 0; a < static_cast<int>(configs.size()); ++a) {
+        for (int b = a + 1; b < static_cast<int>(configs.size()); ++b) {
+            pairs.push_back({ a, b });
+        }
+    }
+
+    // Workers take games by index, so results land in a fixed order and
+    // a run is reproducible whatever the number of workers
+    int game_count = static_cast<int>(pairs.size()) * options.games_per_pair;
+    std::vector<game_result> results(game_count);
+    std::atomic<int> next_game = 0;
+
+    auto worker = [&] {
+        for (int i = next_game++; i < game_count; i = next_game++) {
+            auto [a, b] = pairs[i / options.games_per_pair];
+            int game = i % options.games_per_pair;
+            // Every pair plays the same openings
+            std::uint64_t opening_seed = options.seed * 1'000'003 + game / 2;
+
+            results[i] = game % 2 == 0
+                ? play_game(start, configs, a, b, opening_seed, options)
+                : play_game(start, configs, b, a, opening_seed, options);
+        }
+    };
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.workers; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    auto duration = std::chrono::steady_clock::now() - start_time;
+    double seconds = std::chrono::duration<double>(duration).count();
+
+    auto summaries = summarize(configs, results);
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        const auto& summary = summaries[i];
+        std::cout << configs[i].name
+            << ": partie " << summary.games
+            << ", wygrane " << summary.wins
+            << ", przegrane " << summary.losses
+            << ", remisy " << summary.draws
+            << ", wynik " << 100.0 * win_rate(summary) << "%"
+            << ", sredni czas ruchu " << average_move_ms(summary) << " ms"
+            << (configs[i].engine == engine_kind::MCTS
+                ? ", iteracje/s " + std::to_string(static_cast<std::uint64_t>(iterations_per_second(summary)))
+                : ", wezly/s " + std::to_string(static_cast<std::uint64_t>(nodes_per_second(summary))))
+            << ", srednia dlugosc partii " << average_plies(summary)
+            << std::endl;
+    }
+
+    std::cout << "Rozegrano " << game_count << " partii w "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        << " (" << game_count / seconds << " partii/s, watki: " << options.workers << ")"
+        << std::endl;
+
+    if (csv_path) write_csv(csv_path, configs, results);
+    if (json_path) write_json(json_path, configs, summaries, results);
+
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "metrics.hpp"
+#include "packed_position.hpp"
+
+// Fits the distance tables of the heuristic to self-play results (Texel
+// tuning). The heuristic of the first player is the sum of the table
+// values of the second player's pieces, turned around, minus the sum of
+// its own, and the chance that the first player wins is modelled as
+// sigmoid(K * heuristic). K is fitted to the starting tables first, then
+// the tables are fitted by gradient descent (Adam) on the mean squared
+// error between that chance and the results, a draw counting as half a
+// win. Tables stay symmetric in x and y like the goals of both players,
+// and the corner cell stays 0 since only differences between cells matter.
+// The tuned tables are written in the format board loads, scaled to
+// integers.
+//
+// Usage: tune [--iterations N] [--workers N] [--rate R] [--metric NAME]
+//     [--weights FILE] [--output weights.txt] POSITIONS
+
+// Table values are written as integers in hundredths of a cell
+static constexpr double OUTPUT_SCALE = 100.0;
+
+static constexpr int PARAMETER_COUNT = board::SIZE * (board::SIZE + 1) / 2;
+
+// Piece slots of positions with fewer pieces point at this parameter,
+// which is always 0
+static constexpr int PADDING = PARAMETER_COUNT;
+
+static_assert(PARAMETER_COUNT < 255);
+
+struct tune_options {
+    int iterations = 500;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    double rate = 0.05;
+    metric_kind metric = metric_kind::MANHATTAN;
+};
+
+// Positions as struct of arrays: the parameters of the pieces of both
+// players, pieces_per_position slots per position, and the results. Every
+// evaluation pass walks these arrays in order and looks the parameters up
+// in a table that stays in the first level cache.
+struct position_batch {
+    int pieces_per_position;
+    std::vector<std::uint8_t> first_pieces;
+    std::vector<std::uint8_t> second_pieces;
+    std::vector<double> results;
+
+    std::size_t size() const { return results.size(); }
+};
+
+static bool parse_metric(const std::string& name, metric_kind& out)
+{
+    if (name == "manhattan") out = metric_kind::MANHATTAN;
+    else if (name == "euclidean") out = metric_kind::EUCLIDEAN;
+    else if (name == "chebyshev") out = metric_kind::CHEBYSHEV;
+    else return false;
+
+    return true;
+}
+
+// Cells (x, y) and (y, x) share a parameter
+static int parameter_index(int x, int y)
+{
+    int low = std::min(x, y);
+    int high = std::max(x, y);
+    return high * (high + 1) / 2 + low;
+}
+
+static position_batch make_batch(const std::vector<training_position>& positions)
+{
+    position_batch batch{};
+
+    for (const auto& sample : positions) {
+        int counts[3] = {};
+        for (int cell = 0; cell < board::SIZE * board::SIZE; ++cell) {
+            ++counts[sample.position.get_cell(cell)];
+        }
+        batch.pieces_per_position = std::max({ batch.pieces_per_position, counts[1], counts[2] });
+    }
+
+    std::size_t slots = positions.size() * batch.pieces_per_position;
+    batch.first_pieces.assign(slots, PADDING);
+    batch.second_pieces.assign(slots, PADDING);
+    batch.results.resize(positions.size());
+
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        const auto& sample = positions[i];
+        std::size_t first = i * batch.pieces_per_position;
+        std::size_t second = i * batch.pieces_per_position;
+
+        for (int y = 0; y < board::SIZE; ++y) {
+            for (int x = 0; x < board::SIZE; ++x) {
+                int piece = sample.position.get_cell(y * board::SIZE + x);
+                if (piece == 1) {
+                    batch.first_pieces[first++] = static_cast<std::uint8_t>(parameter_index(x, y));
+                }
+                else if (piece == 2) {
+                    batch.second_pieces[second++] = static_cast<std::uint8_t>(
+                        parameter_index(board::SIZE - 1 - x, board::SIZE - 1 - y));
+                }
+            }
+        }
+
+        batch.results[i] = sample.result / 2.0;
+    }
+
+    return batch;
+}
+
+static double sigmoid(double value)
+{
+    return 1.0 / (1.0 + std::exp(-value));
+}
+
+// Heuristic of the first player in every position of [begin, end)
+static void evaluate_batch(const position_batch& batch, const double* weights,
+    std::size_t begin, std::size_t end, double* out)
+{
+    int pieces = batch.pieces_per_position;
+    const std::uint8_t* first = batch.first_pieces.data() + begin * pieces;
+    const std::uint8_t* second = batch.second_pieces.data() + begin * pieces;
+
+    for (std::size_t i = begin; i < end; ++i) {
+        double score = 0.0;
+        for (int piece = 0; piece < pieces; ++piece) {
+            score += weights[second[piece]] - weights[first[piece]];
+        }
+
+        out[i - begin] = score;
+        first += pieces;
+        second += pieces;
+    }
+}
+
+// Mean squared error over all positions, and its gradient if asked for.
+// Every worker takes one slice of the positions.
+static double compute_error(const position_batch& batch, const std::vector<double>& weights,
+    double k, int workers, std::vector<double>* gradient)
+{
+    std::vector<double> errors(workers);
+    std::vector<std::vector<double>> gradients(workers, std::vector<double>(weights.size()));
+
+    auto worker = [&](int index) {
+        std::size_t begin = batch.size() * index / workers;
+        std::size_t end = batch.size() * (index + 1) / workers;
+        std::vector<double> scores(end - begin);
+        evaluate_batch(batch, weights.data(), begin, end, scores.data());
+
+        int pieces = batch.pieces_per_position;
+        for (std::size_t i = begin; i < end; ++i) {
+            double chance = sigmoid(k * scores[i - begin]);
+            double difference = chance - batch.results[i];
+            errors[index] += difference * difference;
+
+            if (gradient) {
+                double slope = 2.0 * difference * chance * (1.0 - chance) * k;
+                for (int piece = 0; piece < pieces; ++piece) {
+                    gradients[index][batch.second_pieces[i * pieces + piece]] += slope;
+                    gradients[index][batch.first_pieces[i * pieces + piece]] -= slope;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    double error = 0.0;
+    for (int i = 0; i < workers; ++i) {
+        error += errors[i];
+    }
+
+    if (gradient) {
+        gradient->assign(weights.size(), 0.0);
+        for (int i = 0; i < workers; ++i) {
+            for (std::size_t p = 0; p < weights.size(); ++p) {
+                (*gradient)[p] += gradients[i][p] / batch.size();
+            }
+        }
+    }
+
+    return error / batch.size();
+}
+
+// The error is unimodal in K, a ternary search over its logarithm finds
+// the minimum
+static double fit_k(const position_batch& batch, const std::vector<double>& weights, int workers)
+{
+    double low = -10.0;
+    double high = 3.0;
+
+    for (int i = 0; i < 40; ++i) {
+        double first = low + (high - low) / 3;
+        double second = high - (high - low) / 3;
+
+        if (compute_error(batch, weights, std::exp(first), workers, nullptr)
+            < compute_error(batch, weights, std::exp(second), workers, nullptr)) {
+            high = second;
+        }
+        else {
+            low = first;
+        }
+    }
+
+    return std::exp((low + high) / 2);
+}
+
+static bool write_weights(const char* path, const std::vector<double>& weights)
+{
+    std::ofstream out(path);
+    out << board::SIZE << '\n';
+
+    for (int y = 0; y < board::SIZE; ++y) {
+        for (int x = 0; x < board::SIZE; ++x) {
+            out << (x ? " " : "") << std::llround(weights[parameter_index(x, y)] * OUTPUT_SCALE);
+        }
+        out << '\n';
+    }
+
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char* argv[])
+{
+    tune_options options;
+    const char* input_path = nullptr;
+    const char* weights_path = nullptr;
+    const char* output_path = "weights.txt";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            options.rate = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            if (!parse_metric(argv[++i], options.metric)) {
+                std::cerr << "Nieznana metryka " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+            weights_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        }
+        else {
+            input_path = argv[i];
+        }
+    }
+
+    if (!input_path) {
+        std::cerr << "Nie podano pliku z pozycjami" << std::endl;
+        return 1;
+    }
+
+    std::vector<training_position> positions;
+    if (!read_training_positions(input_path, positions) || positions.empty()) {
+        std::cerr << "Nie mozna wczytac pozycji z pliku " << input_path << std::endl;
+        return 1;
+    }
+
+    // Tuning starts from a metric or from earlier tuned tables, whose
+    // values are in hundredths of a cell
+    distance_tables<board::SIZE> start_tables = get_distance_tables<board::SIZE>(options.metric);
+    double start_scale = options.metric == metric_kind::EUCLIDEAN ? 1000.0 : 1.0;
+    if (weights_path) {
+        std::ifstream weights_file(weights_path);
+        if (!read_distance_tables(weights_file, start_tables)) {
+            std::cerr << "Nie mozna wczytac wag z pliku " << weights_path << std::endl;
+            return 1;
+        }
+        start_scale = OUTPUT_SCALE;
+    }
+
+    std::vector<double> weights(PARAMETER_COUNT + 1);
+    for (int x = 0; x < board::SIZE; ++x) {
+        for (int y = 0; y <= x; ++y) {
+            weights[parameter_index(x, y)] = (start_tables.first_corner[x][y] + start_tables.first_corner[y][x])
+                / (2.0 * start_scale);
+        }
+    }
+    weights[parameter_index(0, 0)] = 0.0;
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto batch = make_batch(positions);
+
+    double k = fit_k(batch, weights, options.workers);
+    double start_error = compute_error(batch, weights, k, options.workers, nullptr);
+    std::cout << "Pozycje: " << batch.size() << ", K: " << k << ", blad poczatkowy: " << start_error << std::endl;
+
+    // Adam with the usual decay rates
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    std::vector<double> gradient;
+    std::vector<double> momentum(weights.size());
+    std::vector<double> velocity(weights.size());
+    double error = start_error;
+
+    for (int iteration = 1; iteration <= options.iterations; ++iteration) {
+        error = compute_error(batch, weights, k, options.workers, &gradient);
+
+        double correction1 = 1.0 - std::pow(beta1, iteration);
+        double correction2 = 1.0 - std::pow(beta2, iteration);
+
+        for (int p = 0; p < PARAMETER_COUNT; ++p) {
+            if (p == parameter_index(0, 0)) {
+                continue;
+            }
+
+            momentum[p] = beta1 * momentum[p] + (1 - beta1) * gradient[p];
+            velocity[p] = beta2 * velocity[p] + (1 - beta2) * gradient[p] * gradient[p];
+            weights[p] -= options.rate * (momentum[p] / correction1)
+                / (std::sqrt(velocity[p] / correction2) + 1e-12);
+        }
+
+        if (iteration % 50 == 0) {
+            std::cout << "Iteracja " << iteration << ", blad: " << error << std::endl;
+        }
+    }
+
+    error = compute_error(batch, weights, k, options.workers, nullptr);
+    auto duration = std::chrono::steady_clock::now() - start_time;
+
+    if (!write_weights(output_path, weights)) {
+        std::cerr << "Nie mozna zapisac pliku " << output_path << std::endl;
+        return 1;
+    }
+
+    std::cout << "Blad koncowy: " << error << " (poczatkowy " << start_error << ")"
+        << ", czas: " << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        << ", zapisano wagi do " << output_path << std::endl;
+
+    return 0;
+}